@@ -1,7 +1,14 @@
 #version 400
+#ifdef VISIBILITY_BUFFER
+// made from the triangle of the pixel by visibility.glsl, which calls main as shade_fragment
+vec3 color;
+vec3 normal;
+vec3 vert2eye;
+#else
 in vec3 color;
 in vec3 normal;
 in vec3 vert2eye;
+#endif
 
 
 vec3 g_light0_dir = vec3(1.f, 1.f, 0.5f);
@@ -30,7 +37,7 @@ vec3 diffuse(vec3 n) {
 
 float cook_torrance_chi(float v)
 {
-    return v > 0 ? 1 : 0;
+    return v > 0 ? 1.0 : 0.0;
 }
 
 // schlick fresnel
@@ -0,0 +1,25 @@
+#version 410
+// Repeats each triangle for every view into the viewport of that view, so one draw renders all of them. vertex.glsl
+// runs first with identity transforms and its outputs renamed, the per view transforms are applied here instead.
+layout(triangles, invocations = 7) in;
+layout(triangle_strip, max_vertices = 3) out;
+uniform mat4 ViewMVP[7];
+uniform mat4 ViewM[7];
+uniform vec3 ViewEye[7];
+in vec3 v_color[];
+in vec3 v_normal[];
+out vec3 color;
+out vec3 normal;
+out vec3 vert2eye;
+void main() {
+    for (int i = 0; i < 3; ++i) {
+        vec4 position = gl_in[i].gl_Position;
+        gl_Position = ViewMVP[gl_InvocationID] * position;
+        gl_ViewportIndex = gl_InvocationID;
+        color = v_color[i];
+        normal = v_normal[i];
+        vert2eye = ViewEye[gl_InvocationID] - (position * ViewM[gl_InvocationID]).xyz;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,230 @@
+#include "context.h"
+#include <glad/glad.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef STL2PNG_GLFW
+#include <GLFW/glfw3.h>
+#endif
+#ifdef STL2PNG_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef STL2PNG_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+namespace Graphics {
+
+namespace {
+void set_environment(const char* name, const std::string& value) {
+    // settings made by the user win
+    if (getenv(name)) {
+        return;
+    }
+#ifdef _WIN32
+    _putenv_s(name, value.c_str());
+#else
+    setenv(name, value.c_str(), 0);
+#endif
+}
+
+#ifdef STL2PNG_GLFW
+void error_callback(int error, const char* description) { fprintf(stderr, "Error: %s\n", description); }
+
+class GLFWContext : public GLContext {
+   public:
+    GLFWContext(GLFWwindow* window, bool windowed) : m_window(window), m_windowed(windowed) {}
+    ~GLFWContext() override {
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
+
+    GLFWwindow* window() const override { return m_windowed ? m_window : nullptr; }
+
+   private:
+    GLFWwindow* m_window;
+    bool m_windowed;
+};
+
+std::unique_ptr<GLContext> create_glfw(bool windowed) {
+    glfwSetErrorCallback(error_callback);
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to init glfw");
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    glfwWindowHint(GLFW_VISIBLE, windowed ? GLFW_TRUE : GLFW_FALSE);
+    // headless the window only holds the context
+    GLFWwindow* window = glfwCreateWindow(windowed ? 640 : 1, windowed ? 480 : 1, "STL2PNG", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        fprintf(stderr, "Failed to create glfw window");
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    if (windowed) {
+        glfwSwapInterval(1);
+    }
+    return std::make_unique<GLFWContext>(window, windowed);
+}
+#endif
+
+#ifdef STL2PNG_EGL
+class SurfacelessContext : public GLContext {
+   public:
+    SurfacelessContext(EGLDisplay display, EGLContext context) : m_display(display), m_context(context) {}
+    ~SurfacelessContext() override {
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(m_display, m_context);
+        eglTerminate(m_display);
+    }
+
+   private:
+    EGLDisplay m_display;
+    EGLContext m_context;
+};
+
+std::unique_ptr<GLContext> create_egl() {
+    // the Mesa surfaceless platform needs no window system or GPU, otherwise the default display
+    EGLDisplay display = EGL_NO_DISPLAY;
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless") && get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        fputs("Failed to initialise EGL\n", stderr);
+        return nullptr;
+    }
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API)) {
+        fputs("EGL has no surfaceless desktop OpenGL contexts\n", stderr);
+        eglTerminate(display);
+        return nullptr;
+    }
+    const EGLint config_attributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                        EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) || configs < 1) {
+        fputs("No EGL config for desktop OpenGL\n", stderr);
+        eglTerminate(display);
+        return nullptr;
+    }
+    // no version asked for gives the highest compatibility profile, like the GLFW window
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fputs("Failed to create an EGL context\n", stderr);
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+        return nullptr;
+    }
+    gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+    return std::make_unique<SurfacelessContext>(display, context);
+}
+#endif
+
+#ifdef STL2PNG_OSMESA
+class OSMesaGLContext : public GLContext {
+   public:
+    explicit OSMesaGLContext(OSMesaContext context) : m_context(context) {}
+    ~OSMesaGLContext() override { OSMesaDestroyContext(m_context); }
+
+    // a pixel for OSMesaMakeCurrent, the views are drawn into framebuffer objects
+    std::vector<uint8_t> m_buffer = std::vector<uint8_t>(4);
+
+   private:
+    OSMesaContext m_context;
+};
+
+std::unique_ptr<GLContext> create_osmesa() {
+    const int attributes[] = {OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 0, OSMESA_PROFILE,
+                              OSMESA_COMPAT_PROFILE, 0};
+    OSMesaContext context = OSMesaCreateContextAttribs(attributes, nullptr);
+    if (!context) {
+        fputs("Failed to create an OSMesa context\n", stderr);
+        return nullptr;
+    }
+    auto created = std::make_unique<OSMesaGLContext>(context);
+    if (!OSMesaMakeCurrent(context, created->m_buffer.data(), GL_UNSIGNED_BYTE, 1, 1)) {
+        fputs("Failed to make the OSMesa context current\n", stderr);
+        return nullptr;
+    }
+    gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress);
+    return created;
+}
+#endif
+}  // namespace
+
+bool context_available(ContextBackend backend) {
+    switch (backend) {
+        case ContextBackend::GLFW:
+#ifdef STL2PNG_GLFW
+            return true;
+#else
+            return false;
+#endif
+        case ContextBackend::EGL:
+#ifdef STL2PNG_EGL
+            return true;
+#else
+            return false;
+#endif
+        case ContextBackend::OSMesa:
+#ifdef STL2PNG_OSMESA
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+std::unique_ptr<GLContext> create_context(ContextBackend backend, bool windowed) {
+    if (backend != ContextBackend::GLFW && windowed) {
+        fputs("Only glfw contexts have a window\n", stderr);
+        return nullptr;
+    }
+    switch (backend) {
+        case ContextBackend::GLFW:
+#ifdef STL2PNG_GLFW
+            return create_glfw(windowed);
+#else
+            fputs("Built without GLFW, configure with STL2PNG_GLFW\n", stderr);
+            return nullptr;
+#endif
+        case ContextBackend::EGL:
+#ifdef STL2PNG_EGL
+            return create_egl();
+#else
+            fputs("Built without EGL, configure with STL2PNG_EGL\n", stderr);
+            return nullptr;
+#endif
+        case ContextBackend::OSMesa:
+#ifdef STL2PNG_OSMESA
+            return create_osmesa();
+#else
+            fputs("Built without OSMesa, configure with STL2PNG_OSMESA\n", stderr);
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+void use_software_gl(unsigned threads) {
+    set_environment("LIBGL_ALWAYS_SOFTWARE", "1");
+    set_environment("GALLIUM_DRIVER", "llvmpipe");
+    set_environment("LP_NUM_THREADS", std::to_string(threads));
+}
+}  // namespace Graphics
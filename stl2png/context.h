@@ -0,0 +1,37 @@
+#pragma once
+#include <memory>
+
+struct GLFWwindow;
+
+namespace Graphics {
+
+enum class ContextBackend {
+    // a GLFW window, hidden when headless, needs a window system, built with STL2PNG_GLFW
+    GLFW,
+    // EGL without a surface, on a GPU or Mesa without a window system, built with STL2PNG_EGL
+    EGL,
+    // Mesa's offscreen software rendering, built with STL2PNG_OSMESA
+    OSMesa,
+};
+
+// The GL context the renderer draws with, current on the thread that created it with the GL functions loaded.
+// Headless contexts have no default framebuffer to speak of, everything is drawn into framebuffer objects.
+class GLContext {
+   public:
+    virtual ~GLContext() = default;
+
+    // the visible window of windowed contexts
+    virtual GLFWwindow* window() const { return nullptr; }
+};
+
+// whether the backend was built in
+bool context_available(ContextBackend backend);
+
+// Creates a context and makes it current, only GLFW makes windowed ones. Reports the failure and returns null when
+// there is no such context.
+std::unique_ptr<GLContext> create_context(ContextBackend backend, bool windowed);
+
+// Points Mesa at its multithreaded llvmpipe software driver, rendering on the threads given. Needs to be called
+// before the context is created, other GL drivers ignore it.
+void use_software_gl(unsigned threads);
+}  // namespace Graphics
@@ -0,0 +1,541 @@
+#include "deflate.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "huffman.h"
+#include "simd.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Deflate {
+
+namespace {
+using Huffman::BitWriter;
+using Huffman::canonical_codes;
+using Huffman::huffman_lengths;
+using Huffman::MAX_CODE_LENGTH;
+using Huffman::reverse_bits;
+
+const size_t WINDOW_SIZE = 32768;
+const size_t WINDOW_MASK = WINDOW_SIZE - 1;
+// shorter matches are coded as literals, the match finders compare 4 bytes at a time
+const unsigned MIN_MATCH = 4;
+const unsigned MAX_MATCH = 258;
+const unsigned FAST_HASH_BITS = 14;
+const unsigned CHAIN_HASH_BITS = 15;
+// candidates tried per position, and the match length at which to stop looking for a longer one
+const int MAX_CHAIN = 32;
+const unsigned NICE_MATCH = 128;
+// tokens per dynamic Huffman block
+const size_t BLOCK_TOKENS = 64 * 1024;
+const unsigned MAX_CODE_LENGTH_LENGTH = 7;
+const int LITERALS = 286;
+const int DISTANCES = 30;
+const int CODE_LENGTHS = 19;
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,    65,    97,    129,
+                                193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// order the code length code lengths are written in
+const uint8_t CODE_LENGTH_ORDER[CODE_LENGTHS] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+struct Tables {
+    // length to length code - 257
+    uint8_t m_length_code[MAX_MATCH + 1];
+    // distance - 1 to distance code below 256, (distance - 1) >> 7 above
+    uint8_t m_dist_code[512];
+    // the fixed Huffman codes, bit reversed as they are written least significant bit first
+    uint16_t m_fixed_literal[288];
+    uint8_t m_fixed_literal_length[288];
+    uint16_t m_fixed_dist[DISTANCES];
+
+    Tables() {
+        for (int code = 0; code < 29; ++code) {
+            for (int length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]); ++length) {
+                if (length <= int(MAX_MATCH)) {
+                    m_length_code[length] = uint8_t(code);
+                }
+            }
+        }
+        for (int code = 0; code < DISTANCES; ++code) {
+            for (int dist = DIST_BASE[code]; dist < DIST_BASE[code] + (1 << DIST_EXTRA[code]); ++dist) {
+                if (dist <= 256) {
+                    m_dist_code[dist - 1] = uint8_t(code);
+                } else {
+                    m_dist_code[256 + ((dist - 1) >> 7)] = uint8_t(code);
+                }
+            }
+        }
+        for (int i = 0; i < 288; ++i) {
+            uint32_t code, length;
+            if (i < 144) {
+                code = 0x30 + i, length = 8;
+            } else if (i < 256) {
+                code = 0x190 + i - 144, length = 9;
+            } else if (i < 280) {
+                code = i - 256, length = 7;
+            } else {
+                code = 0xc0 + i - 280, length = 8;
+            }
+            m_fixed_literal[i] = uint16_t(reverse_bits(code, length));
+            m_fixed_literal_length[i] = uint8_t(length);
+        }
+        for (int i = 0; i < DISTANCES; ++i) {
+            m_fixed_dist[i] = uint16_t(reverse_bits(i, 5));
+        }
+    }
+
+    unsigned dist_code(unsigned dist) const {
+        return dist <= 256 ? m_dist_code[dist - 1] : m_dist_code[256 + ((dist - 1) >> 7)];
+    }
+};
+
+const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+// unaligned little endian loads, as on all the targets built for
+inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline unsigned trailing_zeros(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+inline uint32_t hash(uint32_t v, unsigned bits) { return (v * 2654435761u) >> (32 - bits); }
+
+// length of the common prefix of a and b, at most limit
+inline unsigned match_length(const uint8_t* a, const uint8_t* b, unsigned limit) {
+    unsigned length = 0;
+    while (length + 8 <= limit) {
+        const uint64_t diff = load64(a + length) ^ load64(b + length);
+        if (diff) {
+            return length + trailing_zeros(diff) / 8;
+        }
+        length += 8;
+    }
+    while (length < limit && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+// Writes the symbols straight out with the fixed Huffman codes.
+class FixedSink {
+   public:
+    explicit FixedSink(BitWriter& writer) : m_writer(writer), m_tables(tables()) {}
+
+    void literal(uint8_t byte) { m_writer.put(m_tables.m_fixed_literal[byte], m_tables.m_fixed_literal_length[byte]); }
+
+    void match(unsigned length, unsigned dist) {
+        const unsigned lcode = m_tables.m_length_code[length];
+        m_writer.put(m_tables.m_fixed_literal[257 + lcode], m_tables.m_fixed_literal_length[257 + lcode]);
+        if (LENGTH_EXTRA[lcode]) {
+            m_writer.put(length - LENGTH_BASE[lcode], LENGTH_EXTRA[lcode]);
+        }
+        const unsigned dcode = m_tables.dist_code(dist);
+        m_writer.put(m_tables.m_fixed_dist[dcode], 5);
+        if (DIST_EXTRA[dcode]) {
+            m_writer.put(dist - DIST_BASE[dcode], DIST_EXTRA[dcode]);
+        }
+    }
+
+    void end_of_block() { m_writer.put(m_tables.m_fixed_literal[256], m_tables.m_fixed_literal_length[256]); }
+
+   private:
+    BitWriter& m_writer;
+    const Tables& m_tables;
+};
+
+// Collects the symbols of a block and writes it with its own Huffman code, or the fixed code if that is smaller.
+class DynamicSink {
+   public:
+    explicit DynamicSink(BitWriter& writer) : m_writer(writer), m_tables(tables()) { m_tokens.reserve(BLOCK_TOKENS); }
+
+    void literal(uint8_t byte) {
+        m_tokens.push_back(byte);
+        if (m_tokens.size() >= BLOCK_TOKENS) {
+            write_block(false);
+        }
+    }
+
+    void match(unsigned length, unsigned dist) {
+        m_tokens.push_back(MATCH | (length << 15) | (dist - 1));
+        if (m_tokens.size() >= BLOCK_TOKENS) {
+            write_block(false);
+        }
+    }
+
+    void finish(bool final) { write_block(final); }
+
+   private:
+    // tokens are literal bytes, or the flag with the length and distance - 1
+    static const uint32_t MATCH = 1u << 31;
+
+    void write_block(bool final);
+
+    BitWriter& m_writer;
+    const Tables& m_tables;
+    std::vector<uint32_t> m_tokens;
+};
+
+void DynamicSink::write_block(bool final) {
+    uint32_t literal_freq[LITERALS] = {0};
+    uint32_t dist_freq[DISTANCES] = {0};
+    // extra bits are the same for both codes and not counted
+    for (uint32_t token : m_tokens) {
+        if (token & MATCH) {
+            ++literal_freq[257 + m_tables.m_length_code[(token >> 15) & 0x1ff]];
+            ++dist_freq[m_tables.dist_code((token & 0x7fff) + 1)];
+        } else {
+            ++literal_freq[token];
+        }
+    }
+    literal_freq[256] = 1;
+
+    uint8_t lengths[LITERALS + DISTANCES];
+    uint8_t* literal_lengths = lengths;
+    uint8_t* dist_lengths = lengths + LITERALS;
+    huffman_lengths(literal_freq, LITERALS, MAX_CODE_LENGTH, literal_lengths);
+    huffman_lengths(dist_freq, DISTANCES, MAX_CODE_LENGTH, dist_lengths);
+    if (std::find_if(dist_lengths, dist_lengths + DISTANCES, [](uint8_t l) { return l != 0; }) ==
+        dist_lengths + DISTANCES) {
+        // one distance code is needed even without matches
+        dist_lengths[0] = 1;
+    }
+    int literal_count = LITERALS;
+    while (literal_count > 257 && literal_lengths[literal_count - 1] == 0) {
+        --literal_count;
+    }
+    int dist_count = DISTANCES;
+    while (dist_count > 1 && dist_lengths[dist_count - 1] == 0) {
+        --dist_count;
+    }
+
+    // Run length code the literal and distance code lengths as one sequence, 16 repeats the previous length 3-6
+    // times, 17 and 18 are runs of 3-10 and 11-138 zeros
+    struct RunSymbol {
+        uint8_t m_symbol;
+        uint8_t m_extra;
+    };
+    std::vector<RunSymbol> runs;
+    uint8_t sequence[LITERALS + DISTANCES];
+    std::copy(literal_lengths, literal_lengths + literal_count, sequence);
+    std::copy(dist_lengths, dist_lengths + dist_count, sequence + literal_count);
+    const int sequence_count = literal_count + dist_count;
+    for (int i = 0; i < sequence_count;) {
+        const uint8_t length = sequence[i];
+        int run = 1;
+        while (i + run < sequence_count && sequence[i + run] == length) {
+            ++run;
+        }
+        i += run;
+        if (length == 0) {
+            while (run >= 11) {
+                const int n = std::min(run, 138);
+                runs.push_back({18, uint8_t(n - 11)});
+                run -= n;
+            }
+            if (run >= 3) {
+                runs.push_back({17, uint8_t(run - 3)});
+                run = 0;
+            }
+        } else {
+            runs.push_back({length, 0});
+            --run;
+            while (run >= 3) {
+                const int n = std::min(run, 6);
+                runs.push_back({16, uint8_t(n - 3)});
+                run -= n;
+            }
+        }
+        for (; run > 0; --run) {
+            runs.push_back({length, 0});
+        }
+    }
+    uint32_t code_length_freq[CODE_LENGTHS] = {0};
+    for (const auto& r : runs) {
+        ++code_length_freq[r.m_symbol];
+    }
+    // the code length code must be complete, so it needs at least two symbols
+    if (std::count_if(code_length_freq, code_length_freq + CODE_LENGTHS, [](uint32_t f) { return f != 0; }) < 2) {
+        ++code_length_freq[code_length_freq[0] ? 1 : 0];
+    }
+    uint8_t code_length_lengths[CODE_LENGTHS];
+    huffman_lengths(code_length_freq, CODE_LENGTHS, MAX_CODE_LENGTH_LENGTH, code_length_lengths);
+    int code_length_count = CODE_LENGTHS;
+    while (code_length_count > 4 && code_length_lengths[CODE_LENGTH_ORDER[code_length_count - 1]] == 0) {
+        --code_length_count;
+    }
+
+    // pick the smaller of the two codes
+    uint64_t dynamic_bits = 5 + 5 + 4 + 3 * code_length_count;
+    for (const auto& r : runs) {
+        dynamic_bits += code_length_lengths[r.m_symbol];
+        dynamic_bits += r.m_symbol == 16 ? 2 : r.m_symbol == 17 ? 3 : r.m_symbol == 18 ? 7 : 0;
+    }
+    uint64_t fixed_bits = 0;
+    for (int i = 0; i < LITERALS; ++i) {
+        dynamic_bits += uint64_t(literal_freq[i]) * literal_lengths[i];
+        fixed_bits += uint64_t(literal_freq[i]) * m_tables.m_fixed_literal_length[i];
+    }
+    for (int i = 0; i < DISTANCES; ++i) {
+        dynamic_bits += uint64_t(dist_freq[i]) * dist_lengths[i];
+        fixed_bits += uint64_t(dist_freq[i]) * 5;
+    }
+
+    uint16_t literal_codes[LITERALS];
+    uint16_t dist_codes[DISTANCES];
+    uint8_t dist_code_lengths[DISTANCES];
+    m_writer.put(final ? 1 : 0, 1);
+    if (fixed_bits <= dynamic_bits) {
+        m_writer.put(1, 2);
+        for (int i = 0; i < LITERALS; ++i) {
+            literal_codes[i] = m_tables.m_fixed_literal[i];
+            literal_lengths[i] = m_tables.m_fixed_literal_length[i];
+        }
+        std::copy(m_tables.m_fixed_dist, m_tables.m_fixed_dist + DISTANCES, dist_codes);
+        std::fill(dist_code_lengths, dist_code_lengths + DISTANCES, uint8_t(5));
+    } else {
+        m_writer.put(2, 2);
+        m_writer.put(literal_count - 257, 5);
+        m_writer.put(dist_count - 1, 5);
+        m_writer.put(code_length_count - 4, 4);
+        for (int i = 0; i < code_length_count; ++i) {
+            m_writer.put(code_length_lengths[CODE_LENGTH_ORDER[i]], 3);
+        }
+        uint16_t code_length_codes[CODE_LENGTHS];
+        canonical_codes(code_length_lengths, CODE_LENGTHS, code_length_codes);
+        for (const auto& r : runs) {
+            m_writer.put(code_length_codes[r.m_symbol], code_length_lengths[r.m_symbol]);
+            if (r.m_symbol == 16) {
+                m_writer.put(r.m_extra, 2);
+            } else if (r.m_symbol == 17) {
+                m_writer.put(r.m_extra, 3);
+            } else if (r.m_symbol == 18) {
+                m_writer.put(r.m_extra, 7);
+            }
+        }
+        canonical_codes(literal_lengths, LITERALS, literal_codes);
+        canonical_codes(dist_lengths, DISTANCES, dist_codes);
+        std::copy(dist_lengths, dist_lengths + DISTANCES, dist_code_lengths);
+    }
+
+    for (uint32_t token : m_tokens) {
+        if (token & MATCH) {
+            const unsigned length = (token >> 15) & 0x1ff;
+            const unsigned dist = (token & 0x7fff) + 1;
+            const unsigned lcode = m_tables.m_length_code[length];
+            m_writer.put(literal_codes[257 + lcode], literal_lengths[257 + lcode]);
+            if (LENGTH_EXTRA[lcode]) {
+                m_writer.put(length - LENGTH_BASE[lcode], LENGTH_EXTRA[lcode]);
+            }
+            const unsigned dcode = m_tables.dist_code(dist);
+            m_writer.put(dist_codes[dcode], dist_code_lengths[dcode]);
+            if (DIST_EXTRA[dcode]) {
+                m_writer.put(dist - DIST_BASE[dcode], DIST_EXTRA[dcode]);
+            }
+        } else {
+            m_writer.put(literal_codes[token], literal_lengths[token]);
+        }
+    }
+    m_writer.put(literal_codes[256], literal_lengths[256]);
+    m_tokens.clear();
+}
+
+// One hash probe per position. A run of the previous byte is checked first, the most common match in filtered
+// image rows.
+template <typename Sink>
+void match_fast(const uint8_t* data, size_t size, Sink& sink) {
+    std::vector<int32_t> head(size_t(1) << FAST_HASH_BITS, -1);
+    size_t pos = 0;
+    if (size >= MIN_MATCH) {
+        while (pos + MIN_MATCH <= size) {
+            const uint32_t v = load32(data + pos);
+            const unsigned limit = unsigned(std::min<size_t>(MAX_MATCH, size - pos));
+            if (pos > 0 && load32(data + pos - 1) == v) {
+                const unsigned length = match_length(data + pos - 1, data + pos, limit);
+                sink.match(length, 1);
+                pos += length;
+                continue;
+            }
+            int32_t& slot = head[hash(v, FAST_HASH_BITS)];
+            const int32_t candidate = slot;
+            slot = int32_t(pos);
+            if (candidate >= 0 && pos - candidate < WINDOW_SIZE && load32(data + candidate) == v) {
+                const unsigned length = match_length(data + candidate, data + pos, limit);
+                sink.match(length, unsigned(pos - candidate));
+                pos += length;
+            } else {
+                sink.literal(data[pos++]);
+            }
+        }
+    }
+    while (pos < size) {
+        sink.literal(data[pos++]);
+    }
+}
+
+// Hash chains over the window, taking the longest of up to MAX_CHAIN candidates.
+template <typename Sink>
+void match_chains(const uint8_t* data, size_t size, Sink& sink) {
+    std::vector<int32_t> head(size_t(1) << CHAIN_HASH_BITS, -1);
+    std::vector<int32_t> prev(WINDOW_SIZE, -1);
+    auto insert = [&](size_t p) {
+        int32_t& slot = head[hash(load32(data + p), CHAIN_HASH_BITS)];
+        prev[p & WINDOW_MASK] = slot;
+        slot = int32_t(p);
+    };
+    size_t pos = 0;
+    while (pos + MIN_MATCH <= size) {
+        const uint32_t v = load32(data + pos);
+        int32_t& slot = head[hash(v, CHAIN_HASH_BITS)];
+        int32_t candidate = slot;
+        prev[pos & WINDOW_MASK] = slot;
+        slot = int32_t(pos);
+
+        const unsigned limit = unsigned(std::min<size_t>(MAX_MATCH, size - pos));
+        unsigned best_length = 0;
+        size_t best_dist = 0;
+        for (int chain = MAX_CHAIN; chain > 0 && candidate >= 0 && pos - candidate < WINDOW_SIZE; --chain) {
+            const uint8_t* c = data + candidate;
+            // the byte that would make the match longer than the best so far is checked first
+            if (c[best_length] == data[pos + best_length] && load32(c) == v) {
+                const unsigned length = match_length(c, data + pos, limit);
+                if (length > best_length) {
+                    best_length = length;
+                    best_dist = pos - candidate;
+                    if (length >= NICE_MATCH || length == limit) {
+                        break;
+                    }
+                }
+            }
+            candidate = prev[candidate & WINDOW_MASK];
+        }
+        if (best_length >= MIN_MATCH) {
+            sink.match(best_length, unsigned(best_dist));
+            const size_t end = std::min(pos + best_length, size - MIN_MATCH + 1);
+            for (size_t p = pos + 1; p < end; ++p) {
+                insert(p);
+            }
+            pos += best_length;
+        } else {
+            sink.literal(data[pos++]);
+        }
+    }
+    while (pos < size) {
+        sink.literal(data[pos++]);
+    }
+}
+}  // namespace
+
+void compress(const uint8_t* data, size_t size, Level level, bool final, std::vector<uint8_t>& out) {
+    BitWriter writer(out);
+    if (level == Level::Fast) {
+        writer.put(final ? 1 : 0, 1);
+        writer.put(1, 2);
+        FixedSink sink(writer);
+        match_fast(data, size, sink);
+        sink.end_of_block();
+    } else {
+        DynamicSink sink(writer);
+        match_chains(data, size, sink);
+        sink.finish(final);
+    }
+    if (!final) {
+        // an empty stored block, aligning to the next byte
+        writer.put(0, 3);
+        writer.flush();
+        const uint8_t stored[4] = {0x00, 0x00, 0xff, 0xff};
+        out.insert(out.end(), stored, stored + 4);
+    } else {
+        writer.flush();
+    }
+}
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    const uint32_t BASE = 65521;
+    // most bytes that can be summed before b can overflow
+    const size_t NMAX = 5552;
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t n = std::min(size, NMAX);
+        size -= n;
+#ifdef SIMD_X86
+        // 16 bytes at a time, b gains 16 times a before each step and the bytes weighted 16 down to 1
+        if (n >= 16) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i high = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+            const __m128i low = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+            __m128i va = _mm_cvtsi32_si128(int(a)), vb = _mm_cvtsi32_si128(int(b)), steps = zero;
+            for (; n >= 16; n -= 16, data += 16) {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+                steps = _mm_add_epi32(steps, va);
+                va = _mm_add_epi32(va, _mm_sad_epu8(x, zero));
+                vb = _mm_add_epi32(vb, _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(x, zero), high),
+                                                     _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), low)));
+            }
+            vb = _mm_add_epi32(vb, _mm_slli_epi32(steps, 4));
+            auto sum = [](__m128i v) {
+                v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+                v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+                return uint32_t(_mm_cvtsi128_si32(v));
+            };
+            a = sum(va);
+            b = sum(vb);
+        }
+#endif
+        for (; n >= 4; n -= 4, data += 4) {
+            a += data[0];
+            b += a;
+            a += data[1];
+            b += a;
+            a += data[2];
+            b += a;
+            a += data[3];
+            b += a;
+        }
+        for (; n > 0; --n) {
+            a += *data++;
+            b += a;
+        }
+        a %= BASE;
+        b %= BASE;
+    }
+    return a | (b << 16);
+}
+
+uint32_t adler32_combine(uint32_t first, uint32_t second, size_t second_size) {
+    const uint32_t BASE = 65521;
+    const uint32_t rem = uint32_t(second_size % BASE);
+    uint32_t sum1 = first & 0xffff;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % BASE);
+    sum1 += (second & 0xffff) + BASE - 1;
+    sum2 += ((first >> 16) & 0xffff) + ((second >> 16) & 0xffff) + BASE - rem;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum2 >= (BASE << 1)) sum2 -= (BASE << 1);
+    if (sum2 >= BASE) sum2 -= BASE;
+    return sum1 | (sum2 << 16);
+}
+}  // namespace Deflate
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+// Deflate (RFC 1951) compression for the PNG encoder.
+namespace Deflate {
+
+enum class Level {
+    // single probe hash match finder checking for runs first, fixed Huffman codes
+    Fast,
+    // hash chain match finder, a dynamic Huffman code per block
+    Balanced,
+};
+
+// Appends the deflate blocks of data to out, ending byte aligned. Unless final the blocks end with an empty stored
+// block, so pieces compressed independently (matches never reach back before data) can be concatenated into one
+// stream with only the last one final.
+void compress(const uint8_t* data, size_t size, Level level, bool final, std::vector<uint8_t>& out);
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+// Adler-32 of two pieces one after the other, from their checksums and the size of the second.
+uint32_t adler32_combine(uint32_t first, uint32_t second, size_t second_size);
+}  // namespace Deflate
@@ -0,0 +1,85 @@
+#include "framebuffer.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace Graphics {
+
+Framebuffer::~Framebuffer() { release(); }
+
+void Framebuffer::release() {
+    if (m_framebuffer) {
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_color);
+        glDeleteTextures(1, &m_color_texture);
+        glDeleteRenderbuffers(1, &m_depth);
+        m_framebuffer = m_color = m_color_texture = m_depth = 0;
+    }
+    m_width = m_height = 0;
+}
+
+bool Framebuffer::resize(int width, int height, DepthFormat depth, GLenum color) {
+    if (m_framebuffer && width == m_width && height == m_height && depth == m_depth_format &&
+        color == m_color_format) {
+        return true;
+    }
+    release();
+    const bool texture = color != GL_RGBA8;
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    if (texture) {
+        GLint max_texture = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture);
+        max_size = std::min(max_size, max_texture);
+    }
+    if (width < 1 || height < 1 || width > max_size || height > max_size) {
+        fprintf(stderr, "Framebuffer size %dx%d not supported, at most %d either way\n", width, height, max_size);
+        return false;
+    }
+
+    if (texture) {
+        // read with texelFetch, integer formats only have nearest filtering
+        glGenTextures(1, &m_color_texture);
+        glBindTexture(GL_TEXTURE_2D, m_color_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GLint(color), width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    } else {
+        glGenRenderbuffers(1, &m_color);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    }
+    glGenRenderbuffers(1, &m_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+    const GLenum depth_format = depth == DepthFormat::Depth16   ? GL_DEPTH_COMPONENT16
+                                : depth == DepthFormat::Depth24 ? GL_DEPTH_COMPONENT24
+                                                                : GL_DEPTH_COMPONENT32F;
+    glRenderbufferStorage(GL_RENDERBUFFER, depth_format, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    if (texture) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color_texture, 0);
+    } else {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Failed to create a %dx%d framebuffer, status 0x%x\n", width, height, status);
+        release();
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_depth_format = depth;
+    m_color_format = color;
+    return true;
+}
+
+void Framebuffer::bind() const { glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer); }
+
+void Framebuffer::unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+}  // namespace Graphics
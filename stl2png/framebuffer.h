@@ -0,0 +1,49 @@
+#pragma once
+#include <glad/glad.h>
+
+namespace Graphics {
+
+enum class DepthFormat {
+    Depth16,
+    Depth24,
+    Depth32F,
+};
+
+// Offscreen framebuffer object with an RGBA8 color and a depth renderbuffer, rendered to at any size the GL allows
+// independent of the window system. Other color formats are single channel unsigned integer textures shaders can
+// read, such as the R32UI triangles of the visibility buffer.
+class Framebuffer {
+   public:
+    Framebuffer() = default;
+    ~Framebuffer();
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    // (re)creates the renderbuffers when the size or format changes, false when GL cannot make the framebuffer
+    // complete
+    bool resize(int width, int height, DepthFormat depth = DepthFormat::Depth24, GLenum color = GL_RGBA8);
+
+    // binds the framebuffer for drawing and reading, unbind() goes back to the window framebuffer
+    void bind() const;
+    static void unbind();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    // the color texture, 0 for RGBA8 which is a renderbuffer
+    GLuint color_texture() const { return m_color_texture; }
+
+    // deletes the GL objects, before the context goes
+    void release();
+
+   private:
+
+    GLuint m_framebuffer = 0;
+    GLuint m_color = 0;
+    GLuint m_color_texture = 0;
+    GLuint m_depth = 0;
+    int m_width = 0;
+    int m_height = 0;
+    DepthFormat m_depth_format = DepthFormat::Depth24;
+    GLenum m_color_format = GL_RGBA8;
+};
+}  // namespace Graphics
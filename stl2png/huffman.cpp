@@ -0,0 +1,109 @@
+#include "huffman.h"
+#include <algorithm>
+#include <utility>
+
+namespace Huffman {
+
+uint32_t reverse_bits(uint32_t code, unsigned length) {
+    uint32_t reversed = 0;
+    for (unsigned i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+void huffman_lengths(const uint32_t* freq, int count, unsigned limit, uint8_t* lengths) {
+    std::fill(lengths, lengths + count, uint8_t(0));
+    std::vector<std::pair<uint32_t, int>> symbols;
+    for (int i = 0; i < count; ++i) {
+        if (freq[i]) {
+            symbols.emplace_back(freq[i], i);
+        }
+    }
+    if (symbols.empty()) {
+        return;
+    }
+    if (symbols.size() == 1) {
+        lengths[symbols[0].second] = 1;
+        return;
+    }
+    std::sort(symbols.begin(), symbols.end());
+
+    // Two queue construction, the leaves are sorted and the internal nodes are made in increasing weight order
+    const size_t leaves = symbols.size();
+    const size_t nodes = 2 * leaves - 1;
+    std::vector<uint64_t> weight(nodes);
+    std::vector<size_t> parent(nodes, 0);
+    for (size_t i = 0; i < leaves; ++i) {
+        weight[i] = symbols[i].first;
+    }
+    size_t leaf = 0, internal = leaves;
+    auto lightest = [&](size_t made) {
+        if (leaf < leaves && (internal >= made || weight[leaf] <= weight[internal])) {
+            return leaf++;
+        }
+        return internal++;
+    };
+    for (size_t made = leaves; made < nodes; ++made) {
+        const size_t a = lightest(made);
+        const size_t b = lightest(made);
+        weight[made] = weight[a] + weight[b];
+        parent[a] = parent[b] = made;
+    }
+    std::vector<unsigned> depth(nodes, 0);
+    unsigned length_count[33] = {0};
+    for (size_t i = nodes - 1; i-- > 0;) {
+        depth[i] = depth[parent[i]] + 1;
+        if (i < leaves) {
+            ++length_count[std::min(depth[i], 32u)];
+        }
+    }
+
+    // Codes longer than the limit are moved up to it and the tree rebalanced by lengthening shorter codes until
+    // the code is complete again
+    for (unsigned i = limit + 1; i <= 32; ++i) {
+        length_count[limit] += length_count[i];
+    }
+    uint32_t total = 0;
+    for (unsigned i = limit; i > 0; --i) {
+        total += length_count[i] << (limit - i);
+    }
+    while (total != (1u << limit)) {
+        --length_count[limit];
+        for (unsigned i = limit - 1; i > 0; --i) {
+            if (length_count[i]) {
+                --length_count[i];
+                length_count[i + 1] += 2;
+                break;
+            }
+        }
+        --total;
+    }
+
+    // the most frequent symbols get the shortest codes
+    size_t next = leaves;
+    for (unsigned length = 1; length <= limit; ++length) {
+        for (unsigned n = length_count[length]; n > 0; --n) {
+            lengths[symbols[--next].second] = uint8_t(length);
+        }
+    }
+}
+
+void canonical_codes(const uint8_t* lengths, int count, uint16_t* codes) {
+    unsigned length_count[MAX_CODE_LENGTH + 1] = {0};
+    for (int i = 0; i < count; ++i) {
+        ++length_count[lengths[i]];
+    }
+    length_count[0] = 0;
+    unsigned next[MAX_CODE_LENGTH + 1] = {0};
+    unsigned code = 0;
+    for (unsigned bits = 1; bits <= MAX_CODE_LENGTH; ++bits) {
+        code = (code + length_count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    for (int i = 0; i < count; ++i) {
+        codes[i] = lengths[i] ? uint16_t(reverse_bits(next[lengths[i]]++, lengths[i])) : 0;
+    }
+}
+}  // namespace Huffman
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Canonical Huffman codes written least significant bit first, shared by the deflate and WebP lossless encoders.
+namespace Huffman {
+
+const unsigned MAX_CODE_LENGTH = 15;
+
+uint32_t reverse_bits(uint32_t code, unsigned length);
+
+class BitWriter {
+   public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    // at most 32 bits at a time
+    void put(uint32_t bits, unsigned count) {
+        m_bits |= uint64_t(bits) << m_count;
+        m_count += count;
+        if (m_count >= 32) {
+            const uint8_t bytes[4] = {uint8_t(m_bits), uint8_t(m_bits >> 8), uint8_t(m_bits >> 16),
+                                      uint8_t(m_bits >> 24)};
+            m_out.insert(m_out.end(), bytes, bytes + 4);
+            m_bits >>= 32;
+            m_count -= 32;
+        }
+    }
+
+    // pads to a byte boundary and writes out what is left
+    void flush() {
+        while (m_count > 0) {
+            m_out.push_back(uint8_t(m_bits));
+            m_bits >>= 8;
+            m_count = m_count > 8 ? m_count - 8 : 0;
+        }
+        m_bits = 0;
+    }
+
+   private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_bits = 0;
+    unsigned m_count = 0;
+};
+
+// Code lengths of a Huffman code for the frequencies, limited to limit bits. Unused symbols get length 0, a single
+// used symbol gets length 1.
+void huffman_lengths(const uint32_t* freq, int count, unsigned limit, uint8_t* lengths);
+
+// canonical codes for the lengths, at most MAX_CODE_LENGTH bits, bit reversed
+void canonical_codes(const uint8_t* lengths, int count, uint16_t* codes);
+}  // namespace Huffman
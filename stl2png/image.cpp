@@ -0,0 +1,268 @@
+#include "image.h"
+#include <stb_image_write.h>
+#include <cstdio>
+#include "png.h"
+#include "qoi.h"
+#include "webp.h"
+
+namespace {
+bool write_file(const std::string& path, const std::string& header, const uint8_t* data, size_t size) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool written =
+        fwrite(header.data(), 1, header.size(), file) == header.size() && fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    return write_file(path, std::string(), data.data(), data.size());
+}
+
+void report_failure(const std::string& path) { fprintf(stderr, "Failed to write image \"%s\"\n", path.c_str()); }
+
+// BT.601 luma in 8 bit fixed point
+inline uint8_t luma(const uint8_t* rgb) { return uint8_t((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8); }
+
+bool is_gray(const Graphics::Image& image) {
+    const uint8_t* p = image.data();
+    for (size_t i = 0, n = size_t(image.m_width) * image.m_height; i < n; ++i, p += 3) {
+        if (p[0] != p[1] || p[1] != p[2]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Palette of the colors in order of first use and the index of each pixel, false with more than 256 colors
+bool make_palette(const Graphics::Image& image, std::vector<uint8_t>& palette, std::vector<uint8_t>& indices) {
+    // open addressing on the packed color, the opaque alpha byte marks used slots
+    const uint32_t SLOTS = 1024;
+    uint32_t colors[SLOTS] = {0};
+    uint16_t slot_index[SLOTS] = {0};
+    const size_t n = size_t(image.m_width) * image.m_height;
+    indices.resize(n);
+    palette.clear();
+    const uint8_t* p = image.data();
+    for (size_t i = 0; i < n; ++i, p += 3) {
+        const uint32_t color = 0xff000000u | (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+        uint32_t slot = (color * 2654435761u) >> 22;
+        while (colors[slot] != 0 && colors[slot] != color) {
+            slot = (slot + 1) & (SLOTS - 1);
+        }
+        if (colors[slot] == 0) {
+            if (palette.size() == 256 * 3) {
+                return false;
+            }
+            colors[slot] = color;
+            slot_index[slot] = uint16_t(palette.size() / 3);
+            palette.insert(palette.end(), p, p + 3);
+        }
+        indices[i] = uint8_t(slot_index[slot]);
+    }
+    return true;
+}
+}  // namespace
+
+namespace Graphics {
+
+bool reduce_colors(const Image& image, ColorFormat format, Image& reduced) {
+    if (image.m_channels != 3 || format == ColorFormat::RGB || format == ColorFormat::RGBA) {
+        return false;
+    }
+    reduced = Image();
+    reduced.m_width = image.m_width;
+    reduced.m_height = image.m_height;
+    reduced.m_channels = 1;
+    if (format == ColorFormat::Gray || (format == ColorFormat::Auto && is_gray(image))) {
+        const size_t n = size_t(image.m_width) * image.m_height;
+        reduced.m_pixels.resize(n);
+        const uint8_t* p = image.data();
+        for (size_t i = 0; i < n; ++i, p += 3) {
+            reduced.m_pixels[i] = luma(p);
+        }
+        return true;
+    }
+    return make_palette(image, reduced.m_palette, reduced.m_pixels);
+}
+
+bool compare(const Image& a, const Image& b, int tolerance, ImageDifference& difference) {
+    difference = ImageDifference();
+    if (a.m_width != b.m_width || a.m_height != b.m_height || a.m_channels != b.m_channels || a.m_channels < 3 ||
+        !a.m_palette.empty() || !b.m_palette.empty()) {
+        return false;
+    }
+    const size_t n = size_t(a.m_width) * a.m_height;
+    const uint8_t* p = a.data();
+    const uint8_t* q = b.data();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i, p += a.m_channels, q += b.m_channels) {
+        int pixel = 0;
+        for (int c = 0; c < 3; ++c) {
+            const int d = p[c] > q[c] ? p[c] - q[c] : q[c] - p[c];
+            pixel = d > pixel ? d : pixel;
+            sum += d;
+        }
+        difference.m_max = pixel > difference.m_max ? pixel : difference.m_max;
+        difference.m_pixels += pixel > tolerance ? 1 : 0;
+    }
+    difference.m_mean = n > 0 ? double(sum) / double(n * 3) : 0.0;
+    return true;
+}
+
+bool write_png(const Image& image, const std::string& path, PNGEncoder encoder, ThreadPool* pool) {
+    bool written = false;
+    if (encoder == PNGEncoder::Stb && image.m_palette.empty()) {
+        written = stbi_write_png(path.c_str(), image.m_width, image.m_height, image.m_channels, image.data(),
+                                 image.stride()) == 1;
+    } else {
+        const PNG::Mode mode = encoder == PNGEncoder::Fast       ? PNG::Mode::Fast
+                               : encoder == PNGEncoder::Parallel ? PNG::Mode::Parallel
+                                                                 : PNG::Mode::Balanced;
+        std::vector<uint8_t> png;
+        PNG::encode(image.data(), image.m_width, image.m_height, image.m_channels, image.stride(), image.m_palette,
+                    mode, pool, png);
+        written = write_file(path, png);
+    }
+    if (!written) {
+        report_failure(path);
+    }
+    return written;
+}
+
+namespace {
+class PNGImageEncoder : public ImageEncoder {
+   public:
+    PNGImageEncoder(PNGEncoder encoder, ThreadPool* pool) : m_encoder(encoder), m_pool(pool) {}
+
+    const char* extension() const override { return "png"; }
+    bool accepts(const Image&, ColorFormat) const override { return true; }
+    bool write(const Image& image, const std::string& path) const override {
+        return write_png(image, path, m_encoder, m_pool);
+    }
+
+   private:
+    PNGEncoder m_encoder;
+    ThreadPool* m_pool;
+};
+
+class QOIImageEncoder : public ImageEncoder {
+   public:
+    const char* extension() const override { return "qoi"; }
+    // RGB and RGBA only
+    bool accepts(const Image&, ColorFormat) const override { return false; }
+    bool write(const Image& image, const std::string& path) const override {
+        std::vector<uint8_t> qoi;
+        QOI::encode(image.data(), image.m_width, image.m_height, image.m_channels, image.stride(), qoi);
+        if (write_file(path, qoi) == false) {
+            report_failure(path);
+            return false;
+        }
+        return true;
+    }
+};
+
+class PPMImageEncoder : public ImageEncoder {
+   public:
+    const char* extension() const override { return "ppm"; }
+    bool accepts(const Image&, ColorFormat) const override { return false; }
+    bool write(const Image& image, const std::string& path) const override {
+        const std::string header =
+            "P6\n" + std::to_string(image.m_width) + " " + std::to_string(image.m_height) + "\n255\n";
+        bool written = false;
+        if (image.m_channels == 3) {
+            written = write_file(path, header, image.data(), size_t(image.stride()) * image.m_height);
+        } else {
+            // without the alpha channel, the views are opaque
+            std::vector<uint8_t> rgb(size_t(image.m_width) * image.m_height * 3);
+            const uint8_t* src = image.data();
+            for (size_t i = 0, n = size_t(image.m_width) * image.m_height; i < n; ++i, src += image.m_channels) {
+                rgb[i * 3] = src[0];
+                rgb[i * 3 + 1] = src[1];
+                rgb[i * 3 + 2] = src[2];
+            }
+            written = write_file(path, header, rgb.data(), rgb.size());
+        }
+        if (!written) {
+            report_failure(path);
+        }
+        return written;
+    }
+};
+
+class PAMImageEncoder : public ImageEncoder {
+   public:
+    const char* extension() const override { return "pam"; }
+    // no palettes
+    bool accepts(const Image& reduced, ColorFormat) const override { return reduced.m_palette.empty(); }
+    bool write(const Image& image, const std::string& path) const override {
+        static const char* TUPLE_TYPES[5] = {"", "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"};
+        const std::string header = "P7\nWIDTH " + std::to_string(image.m_width) + "\nHEIGHT " +
+                                   std::to_string(image.m_height) + "\nDEPTH " + std::to_string(image.m_channels) +
+                                   "\nMAXVAL 255\nTUPLTYPE " + TUPLE_TYPES[image.m_channels] + "\nENDHDR\n";
+        if (write_file(path, header, image.data(), size_t(image.stride()) * image.m_height) == false) {
+            report_failure(path);
+            return false;
+        }
+        return true;
+    }
+};
+
+class RawImageEncoder : public ImageEncoder {
+   public:
+    const char* extension() const override { return "raw"; }
+    // the channels stay as asked for, gray only when forced
+    bool accepts(const Image& reduced, ColorFormat requested) const override {
+        return reduced.m_palette.empty() && requested == ColorFormat::Gray;
+    }
+    bool write(const Image& image, const std::string& path) const override {
+        if (write_file(path, std::string(), image.data(), size_t(image.stride()) * image.m_height) == false) {
+            report_failure(path);
+            return false;
+        }
+        return true;
+    }
+};
+
+class WebPImageEncoder : public ImageEncoder {
+   public:
+    const char* extension() const override { return "webp"; }
+    // subtract green already leaves nothing to code for gray pixels, so only the luma of forced gray is worth it
+    bool accepts(const Image& reduced, ColorFormat requested) const override {
+        return reduced.m_palette.empty() && requested == ColorFormat::Gray;
+    }
+    bool write(const Image& image, const std::string& path) const override {
+        std::vector<uint8_t> webp;
+        if (WebP::encode(image.data(), image.m_width, image.m_height, image.m_channels, image.stride(), webp) ==
+            false) {
+            fprintf(stderr, "Image too large for WebP, at most %d pixels either way\n", WebP::MAX_SIZE);
+            return false;
+        }
+        if (write_file(path, webp) == false) {
+            report_failure(path);
+            return false;
+        }
+        return true;
+    }
+};
+}  // namespace
+
+std::unique_ptr<ImageEncoder> make_encoder(ImageFormat format, PNGEncoder png, ThreadPool* pool) {
+    switch (format) {
+        case ImageFormat::QOI:
+            return std::make_unique<QOIImageEncoder>();
+        case ImageFormat::PPM:
+            return std::make_unique<PPMImageEncoder>();
+        case ImageFormat::PAM:
+            return std::make_unique<PAMImageEncoder>();
+        case ImageFormat::Raw:
+            return std::make_unique<RawImageEncoder>();
+        case ImageFormat::WebP:
+            return std::make_unique<WebPImageEncoder>();
+        case ImageFormat::PNG:
+            break;
+    }
+    return std::make_unique<PNGImageEncoder>(png, pool);
+}
+}  // namespace Graphics
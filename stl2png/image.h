@@ -0,0 +1,98 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+namespace Graphics {
+
+// 8 bits per channel pixels as read back from the framebuffer, rows bottom up. The pixels are either owned or point
+// into memory kept by someone else, such as a mapped pixel pack buffer. Paletted images have one channel of indices
+// into the palette of RGB triples.
+struct Image {
+    int m_width = 0;
+    int m_height = 0;
+    int m_channels = 4;
+    std::vector<uint8_t> m_pixels;
+    const uint8_t* m_mapped = nullptr;
+    std::vector<uint8_t> m_palette;
+
+    const uint8_t* data() const { return m_mapped ? m_mapped : m_pixels.data(); }
+    int stride() const { return m_width * m_channels; }
+};
+
+enum class ColorFormat {
+    // RGB reduced to gray or a palette when no color is lost
+    Auto,
+    RGBA,
+    RGB,
+    // luma of RGB
+    Gray,
+    // a palette when there are at most 256 colors, RGB otherwise
+    Palette,
+};
+
+// channels read back for the format, only RGBA needs the alpha channel
+inline int readback_channels(ColorFormat format) { return format == ColorFormat::RGBA ? 4 : 3; }
+
+// Converts a read back RGB image to gray or a palette as the format asks for, false leaves the image as it is.
+bool reduce_colors(const Image& image, ColorFormat format, Image& reduced);
+
+// How far apart two images are in their colour channels
+struct ImageDifference {
+    int m_max = 0;
+    double m_mean = 0.0;
+    // pixels with a channel more than the tolerance apart
+    size_t m_pixels = 0;
+};
+
+// Compares images of the same size and channels, false when they are not.
+bool compare(const Image& a, const Image& b, int tolerance, ImageDifference& difference);
+
+enum class PNGEncoder {
+    // stb_image_write
+    Stb,
+    // the modes of png.h
+    Fast,
+    Balanced,
+    Parallel,
+};
+
+// Writes the image as a PNG file, rows in memory order. The pool is used by the parallel encoder. Paletted images are
+// written with the balanced encoder when stb is asked for, which has no palettes.
+bool write_png(const Image& image, const std::string& path, PNGEncoder encoder = PNGEncoder::Stb,
+               ThreadPool* pool = nullptr);
+
+enum class ImageFormat {
+    PNG,
+    // several times faster to write than PNG, somewhat larger
+    QOI,
+    // uncompressed binary netpbm, PPM for RGB only and PAM for any channels
+    PPM,
+    PAM,
+    // the pixels as read back without a header
+    Raw,
+    // lossless, smaller than PNG
+    WebP,
+};
+
+// Writes images in one file format, rows in memory order. Used by several encoder threads at once.
+class ImageEncoder {
+   public:
+    virtual ~ImageEncoder() = default;
+
+    // file name extension, without the dot
+    virtual const char* extension() const = 0;
+
+    // whether an image reduce_colors made for the requested format is written as it is, otherwise the read back
+    // image is written instead
+    virtual bool accepts(const Image& reduced, ColorFormat requested) const = 0;
+
+    virtual bool write(const Image& image, const std::string& path) const = 0;
+};
+
+// The encoder for the format, PNG files are written with the PNG encoder and pool.
+std::unique_ptr<ImageEncoder> make_encoder(ImageFormat format, PNGEncoder png = PNGEncoder::Stb,
+                                           ThreadPool* pool = nullptr);
+}  // namespace Graphics
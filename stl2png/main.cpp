@@ -1,366 +1,155 @@
-#include <glad/glad.h>
-#include <glfw/glfw3.h>
-#include <stb_image_write.h>
 #include <stdint.h>
 #include <algorithm>
-#include <array>
 #include <cctype>
+#include <filesystem>
 #include <fstream>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/mat4x4.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/component_wise.hpp>
-#include <glm/vec3.hpp>
 #include <iostream>
-#include <optional>
-#include <sstream>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
+#include "context.h"
+#include "model.h"
+#include "options.h"
+#include "pipeline.h"
+#include "renderer.h"
+#include "thread_pool.h"
 
 namespace {
-std::streamsize tell_file_size(std::ifstream& fs) {
-    std::streamsize at = fs.tellg();
-    fs.ignore(std::numeric_limits<std::streamsize>::max());
-    std::streamsize sz = fs.gcount();
-    fs.seekg(at);
-    return at + sz;
-}
-bool file_to_string(const std::string& file, std::string& str) {
-    if (std::ifstream fs = std::ifstream(file)) {
-        str = std::string((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
-        return true;
-    } else {
-        return false;
-    }
-}
-}  // namespace
-
-namespace STL {
-struct STLfacet {
-    glm::vec3 m_normal;
-    glm::vec3 m_vertices[3];
-    uint16_t m_attribute;
-};
-
-typedef std::vector<STLfacet> STLdata;
-
-const int STL_ELEM_SIZE = 3 * 4;
-const int STL_TRIANGLE_SIZE = 4 * (STL_ELEM_SIZE /*normal*/ + 3 * STL_ELEM_SIZE /*verts*/) + 2 /*attribute*/;
-const int STL_MIN_SIZE = 4 + STL_TRIANGLE_SIZE;
-
-std::optional<STLdata> read(const std::string& file) {
-    if (std::ifstream fs = std::ifstream(file, std::ios_base::binary)) {
-        STLdata data;
-        std::streamsize sz = ::tell_file_size(fs);
-
-        if (sz < 80) {
-            std::fputs("Not a binary STL...", stderr);
-            // TODO: try parse ascii instead?
-            return {};
+// Reads a list of STL files, one per line. Blank lines and lines starting with # are skipped.
+bool read_file_list(std::istream& in, std::vector<std::string>& files) {
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
         }
-
-        // try read header
-        char header[81];
-        fs.read(header, 80);
-        if (fs.gcount() != 80) {
-            std::fputs("Failed reading file...", stderr);
-            return {};
-        }
-        std::string header_str(header, 80);
-        if (header_str.find("solid") != std::string::npos) {
-            std::fputs("Not a binary STL...", stderr);
-            // TODO: try parse ascii instead?
-            return {};
-        }
-
-        int64_t data_size = sz - 80 - 4;
-        if (data_size < STL_MIN_SIZE) {
-            std::fputs("Invalid binary STL...", stderr);
-            return {};
-        }
-
-        uint32_t num_facets{0};
-        fs.read(reinterpret_cast<char*>(&num_facets), 4);
-        auto read_bytes = fs.gcount();
-        if (read_bytes != 4) {
-            fputs("Failed reading num facets from file...", stderr);
-            return {};
-        }
-        data.resize(num_facets);
-
-        constexpr auto read_stl_elem = [](glm::vec3& to, std::ifstream& fs) -> bool {
-            fs.read(reinterpret_cast<char*>(glm::value_ptr(to)), STL_ELEM_SIZE);
-            return fs.gcount() == STL_ELEM_SIZE;
-        };
-        for (auto& face : data) {
-            if (read_stl_elem(face.m_normal, fs) == false) {
-                fputs("Failed reading facet from file...", stderr);
-                return {};
-            }
-            for (auto& v : face.m_vertices) {
-                if (read_stl_elem(v, fs) == false) {
-                    fputs("Failed reading vertex from file...", stderr);
-                    return {};
-                }
-            }
-            fs.read(reinterpret_cast<char*>(&face.m_attribute), 2);
-            if (fs.gcount() != 2) {
-                fputs("Failed reading facet from file...", stderr);
-                return {};
-            }
-        }
-        return data;
-    } else {
-        fprintf(stderr, "Cannot open file, \"%s\"", file.c_str());
-        return {};
+        const size_t last = line.find_last_not_of(" \t\r");
+        files.emplace_back(line.substr(first, last - first + 1));
     }
+    return !in.bad();
 }
-}  // namespace STL
-
-namespace Graphics {
 
-void error_callback(int error, const char* description) { fprintf(stderr, "Error: %s\n", description); }
-
-#pragma pack(1)
-struct Vert {
-    Vert(const glm::vec3& pos, const glm::vec3& normal)
-        : x(pos[0]), y(pos[1]), z(pos[2]), nx(normal[0]), ny(normal[1]), nz(normal[2]) {}
-    float x = 0.f, y = 0.f, z = 0.f;
-    float nx = 0.f, ny = 0.f, nz = 0.f;
-    static const int position_offset = 0;
-    static const int position_elements = 3;
-    static const int position_type = GL_FLOAT;
-    static const int normal_offset = 3 * sizeof(float);
-    static const int normal_elements = 3;
-    static const int normal_type = GL_FLOAT;
-};
-
-void fill_vertex_buffer(const STL::STLdata& data, std::vector<Vert>& vertices, glm::vec3& vmin, glm::vec3& vmax,
-                        glm::vec3& centroid) {
-    using namespace glm;
-    vmin = vec3(FLT_MAX);
-    vmax = vec3(-FLT_MAX);
-    centroid = vec3(0.f);
-    for (auto& f : data) {
-        vec3 fn = f.m_normal;
-		if (length(fn) < 1e-5f) {
-			fn = normalize(cross(f.m_vertices[1] - f.m_vertices[0], f.m_vertices[2] - f.m_vertices[0]));
-		}
-		else {
-			fn = normalize(f.m_normal);
-		}
-		for (auto& v : f.m_vertices) {
-            vertices.emplace_back(v, fn);
-            vmin = glm::min(vmin, v);
-            vmax = glm::max(vmax, v);
-            centroid += (v / (data.size() * 3.f));
+// Output directory of each file, in batches a directory per file named after it below the output directory
+std::vector<std::string> output_dirs(const std::vector<std::string>& files, const std::string& out, bool batch) {
+    std::vector<std::string> dirs;
+    if (!batch) {
+        dirs.assign(files.size(), out);
+        return dirs;
+    }
+    std::set<std::string> used;
+    for (const auto& file : files) {
+        std::string stem = std::filesystem::path(file).stem().string();
+        std::string name = stem;
+        // files with the same name from different directories get numbered
+        for (int n = 2; !used.insert(name).second; ++n) {
+            name = stem + "_" + std::to_string(n);
         }
+        dirs.emplace_back((std::filesystem::path(out) / name).string());
     }
+    return dirs;
 }
 
-bool compileGLSLShaderFromFile(const std::string& file, GLint type, GLuint& shader_object) {
-    std::string shader_code;
-    if (::file_to_string(file, shader_code) == false) {
-        fprintf(stderr, "Failed to read %s", file.c_str());
-        return false;
-    }
-    GLint shader_code_len = static_cast<GLint>(shader_code.size());
-    const GLchar* shader_string[] = {nullptr};
-    shader_string[0] = shader_code.data();
-    shader_object = glCreateShader(type);
-    glShaderSource(shader_object, 1, shader_string, &shader_code_len);
-    glCompileShader(shader_object);
-
-    GLint params = GL_FALSE;
-    glGetShaderiv(shader_object, GL_COMPILE_STATUS, &params);
-    if (params != GL_TRUE) {
-        GLint maxLength = 0;
-        glGetShaderiv(shader_object, GL_INFO_LOG_LENGTH, &maxLength);
-        std::vector<GLchar> errorLog(maxLength);
-        glGetShaderInfoLog(shader_object, maxLength, &maxLength, &errorLog[0]);
-        fprintf(stderr, "(%s) Shader compilation error: %s", file.c_str(), errorLog.data());
+// A size given as N for N by N or as WxH, both at least 1
+bool parse_size(const std::string& size, int& width, int& height) {
+    const size_t x = size.find('x');
+    const int w = std::atoi(size.c_str());
+    const int h = x == std::string::npos ? w : std::atoi(size.c_str() + x + 1);
+    if (w < 1 || h < 1) {
         return false;
     }
+    width = w;
+    height = h;
     return true;
 }
-}  // namespace Graphics
-
-int render_stl(const std::string& stl, bool windowed) {
-    using glm::mat4;
-    using glm::vec3;
-    if (auto data = STL::read(stl)) {
-        GLFWwindow* window{nullptr};
-        glfwSetErrorCallback(Graphics::error_callback);
-
-        if (!glfwInit()) {
-            fprintf(stderr, "Failed to init glfw");
-            return -1;
-        }
-
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-        glfwWindowHint(GLFW_VISIBLE, windowed ? GLFW_TRUE : GLFW_FALSE);
-        window = glfwCreateWindow(640, 480, "STL2PNG", nullptr, nullptr);
-        if (!window) {
-            glfwTerminate();
-            fprintf(stderr, "Failed to create glfw window");
-            return -1;
-        }
-
-        glfwMakeContextCurrent(window);
-        gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-        glfwSwapInterval(1);
-
-        GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-        if (Graphics::compileGLSLShaderFromFile("vertex.glsl", GL_VERTEX_SHADER, vertex_shader) == false) {
-            return -1;
-        }
-        if (Graphics::compileGLSLShaderFromFile("fragment.glsl", GL_FRAGMENT_SHADER, fragment_shader) == false) {
-            return -1;
-        }
-        program = glCreateProgram();
-        glAttachShader(program, vertex_shader);
-        glAttachShader(program, fragment_shader);
-        glLinkProgram(program);
-        GLint params = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &params);
-        if (params != GL_TRUE) {
-            fputs("Failed to link shader program", stderr);
-            return -1;
-        }
-
-        glGenBuffers(1, &vertex_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-        std::vector<Graphics::Vert> vertices;
-        vec3 vert_min, vert_max, model_center;
-        fill_vertex_buffer(*data, vertices, vert_min, vert_max, model_center);
-        auto buffer_size = sizeof(vertices) * vertices.size();
-        glBufferData(GL_ARRAY_BUFFER, buffer_size, reinterpret_cast<void*>(vertices.data()), GL_STATIC_DRAW);
-
-        GLint mvp_location, vposition_location, vnormal_location, eye_location, model_location;
-        mvp_location = glGetUniformLocation(program, "MVP");
-        eye_location = glGetUniformLocation(program, "Eye");
-        model_location = glGetUniformLocation(program, "M");
-        vposition_location = glGetAttribLocation(program, "vPosition");
-        vnormal_location = glGetAttribLocation(program, "vNormal");
-
-        glEnableVertexAttribArray(vposition_location);
-        glVertexAttribPointer(vposition_location, Graphics::Vert::position_elements, Graphics::Vert::position_type,
-                              GL_FALSE, sizeof(Graphics::Vert),
-                              reinterpret_cast<void*>(Graphics::Vert::position_offset));
-        if (vnormal_location >= 0) {
-            glEnableVertexAttribArray(vnormal_location);
-            glVertexAttribPointer(vnormal_location, Graphics::Vert::normal_elements, Graphics::Vert::normal_type,
-                                  GL_FALSE, sizeof(Graphics::Vert),
-                                  reinterpret_cast<const void*>(int(Graphics::Vert::normal_offset)));
-        }
-
-        // Figure out a model to world matrix that normalizes the model scale and center
-        float scale = 2.f / glm::compMax(vert_max - vert_min);
-        vec3 translate = -model_center;
-        mat4 model_T = glm::translate(mat4(1.f), translate);
-        mat4 model_S = glm::scale(mat4(1.f), vec3(scale));
-        mat4 model = model_S * model_T;
-
-        struct View {
-            mat4 m_viewMat;
-            mat4 m_modelMat;
-            vec3 m_eyeVec;
-            bool m_perspective = true;
-            std::string m_viewName;
-        };
-
-        float vd = 4.f;
-        using glm::lookAt;
-        std::array<View, 7> render_views = {
-            View{lookAt(vec3(vd, 0.f, 0.f), vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(vd, 0.f, 0.f),  true, "px"},
-            View{lookAt(vec3(-vd, 0.f, 0.f),vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(-vd, 0.f, 0.f), true, "nx"},
-            View{lookAt(vec3(0.f, vd, 0.f), vec3(0.f), vec3(0.f, 0.f, 1.f)), model, vec3(0.f, vd, 0.f),  true, "py"},
-            View{lookAt(vec3(0.f, -vd, 0.f),vec3(0.f), vec3(0.f, 0.f, 1.f)), model, vec3(0.f, -vd, 0.f), true, "ny"},
-            View{lookAt(vec3(0.f, 0.f, vd), vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(0.f, 0.f, vd),  true, "pz"},
-            View{lookAt(vec3(0.f, 0.f, -vd),vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(0.f, 0.f, -vd), true, "nz"},
-            View{lookAt(vec3(vd, vd, vd),   vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(vd, vd, vd),   false, "or"},
-        };
-
-        auto draw_gl_view = [](const View& view, int width, int height, GLuint program, GLuint mvp_loc, GLuint eye_loc,
-                               GLuint model_loc, GLsizei verts) {
-            float ratio = width / (float)height;
-            mat4 proj;
-            if (view.m_perspective) {
-                proj = glm::perspective(45.0f, ratio, 0.1f, 100.f);
-            } else {
-                float os = 2.5;
-                proj = glm::ortho(-os * ratio, os * ratio, -os, os, 0.f, 100.f);
-            }
-            glViewport(0, 0, width, height);
-            glClearColor(0.1f, 0.1f, 0.1f, 1.f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glUseProgram(program);
-            glm::mat4 mvp = proj * view.m_viewMat * view.m_modelMat;
-            glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, glm::value_ptr(mvp));
-            glUniform3fv(eye_loc, 1, glm::value_ptr(view.m_eyeVec));
-            glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(view.m_modelMat));
-            glDisable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
-            glDrawArrays(GL_TRIANGLES, 0, verts);
-        };
-        if (windowed) {
-            // show a window cycling through the views, showing each for a set number of frames
-            signed count = 0;
-            signed frames_per_view = 100;
-            while (!glfwWindowShouldClose(window)) {
-                int width{0}, height{0};
-                glfwGetFramebufferSize(window, &width, &height);
-                draw_gl_view(render_views[count / frames_per_view], width, height, program, mvp_location, eye_location,
-                             model_location, static_cast<GLsizei>(vertices.size()));
-                glfwSwapBuffers(window);
-                glfwPollEvents();
-                ++count;
-                count %= (frames_per_view * render_views.size());
-            }
-        } else {
-            // headless render to framebuffer and write out png files
-            int channels = 4;
-            int bytes_per_channel = 1;
-            glfwSetWindowSize(window, 1920, 1080);
-            int width{0}, height{0};
-            glfwGetFramebufferSize(window, &width, &height);
-            float ratio = width / (float)height;
-            for (const auto& view : render_views) {
-                draw_gl_view(view, width, height, program, mvp_location, eye_location, model_location,
-                             static_cast<GLsizei>(vertices.size()));
-
-                std::vector<uint8_t> pixels;
-                pixels.resize(width * height * channels * bytes_per_channel);
-                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}  // namespace
 
-                std::stringstream name;
-                name << std::string("view_") << view.m_viewName << ".png";
-                int stride = width * channels * bytes_per_channel;
-                if (stbi_write_png(name.str().c_str(), width, height, channels, pixels.data(), stride) != 1) {
-                    fprintf(stderr, "Failed to write image \"%s\"", name.str().c_str());
-                    return -1;
-                }
-            }
-        }
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return 0;
-    } else {
+// Opens a window cycling through the views of the file
+int show_stl(const std::string& stl, const RenderOptions& opts, ThreadPool& pool) {
+    Graphics::LoadedModel model;
+    // the vertices are converted in the background while the context is created
+    if (Graphics::load_model(stl, opts, pool, model) == false) {
+        fprintf(stderr, "Failed to load \"%s\"\n", stl.c_str());
+        return -1;
+    }
+    Graphics::GLRenderer renderer;
+    if (renderer.init(true) == false) {
+        return -1;
+    }
+    if ((opts.m_shading == Graphics::ShadingMode::Visibility && renderer.init_visibility() == false) ||
+        (opts.m_shading == Graphics::ShadingMode::Prepass && renderer.init_depth_prepass() == false)) {
+        fputs("Shading every fragment instead\n", stderr);
+    }
+    if (renderer.upload(model, opts, pool) == false) {
         return -1;
     }
+    renderer.show();
+    return 0;
 }
 
 void print_usage() {
     std::fputs(R"(
 Usage:	
-	stl2png [-window] file.stl
+	stl2png [-window] [-nommap] [-threads N] [-stream] [-blocksize N] [-weld] [-weldeps E] [-smooth] [-crease A]
+		[-optimize] [-compact] [-list F] [-out D] [-loaders N] [-encoders N]
+		[-pbos N] [-png E] [-color C] [-format F] [-atlas T] [-multiview]
+		[-size WxH] [-depth D] [-context C] [-software] [-renderer R] [-verify]
+		[-shading S] [-passtimes] file.stl [file.stl ...]
 	
-	Given an STL binary file renders 7 views and outputs as view_xx.png in same current directory.
-	Needs fragment.glsl and vertex.glsl in current directory.
-
-		-window		option will open a renderwindow and draw the object
+	Given an STL file (binary or ASCII) renders 7 views and outputs as view_xx.png in same current directory.
+	Given several files, or a list, renders them all in one batch and outputs the views of each file in a directory
+	named after the file. Needs fragment.glsl and vertex.glsl in current directory, multiview.glsl for -multiview and
+	visibility.glsl for -shading visibility.
+
+		-window		option will open a renderwindow and draw the object with the GL
+		-nommap		read a copy of the file instead of memory mapping it
+		-threads N	number of threads used to load the model, defaults to all hardware threads
+		-stream		read binary files in blocks straight into the GPU buffer, bounding host memory
+		-blocksize N	facets per block when streaming, defaults to 65536
+		-weld		merge shared vertices and draw indexed, not with -stream
+		-weldeps E	merge positions in the same E sized grid cell instead of only exact matches
+		-smooth		weld with smoothed vertex normals
+		-crease A	faces meeting at more than A degrees keep sharp normals when smoothing, defaults to 30
+		-optimize	weld and reorder triangles and vertices for the GPU vertex caches, reports the welded vertices
+				and the ACMR
+		-compact	upload 12 byte quantised vertices instead of 24 byte float vertices, not with -stream
+		-list F		also render the files listed in F, one per line, or read from stdin if F is -
+		-out D		write the views into D, in batches the per file directories are created in D
+		-loaders N	number of threads loading the next files while rendering, defaults to 1
+		-encoders N	number of threads writing images while rendering, defaults to all hardware threads
+		-pbos N		read views back asynchronously through N pixel buffers the encoders read directly, defaults to 3,
+				0 reads synchronously
+		-png E		PNG encoder, stb (default), fast (fixed Huffman codes), balanced (adaptive row filters) or
+				parallel (balanced, compressing chunks of rows on all threads)
+		-color C	pixel format of the images, rgba (default), auto (gray or a palette of up to 256 colors when
+				lossless, RGB otherwise), rgb, gray or palette (RGB beyond 256 colors); palettes need a png.h
+				encoder and use balanced in place of stb
+		-format F	image file format, png (default), qoi (fast, larger), ppm or pam (uncompressed netpbm), raw (the
+				pixels as read back, no header) or webp (lossless, smaller and slower than png); only png keeps
+				palettes, pam and -color gray with raw or webp keep gray
+		-atlas T	draw all views into one atlas image of 4x2 tiles of T pixels, or WxH, read back at once and
+				written with atlas.json giving the tile of each view, rows counted in image memory order
+		-multiview	draw all views in one pass over the model, a geometry shader sends each triangle to the
+				viewport of every view in an offscreen framebuffer, needs OpenGL 4.1
+		-size WxH	size of the offscreen framebuffer the views are drawn in, defaults to 1920x1080, any size the
+				GL supports such as 8192x8192
+		-depth D	depth buffer format, 16, 24 (default) or 32f (float)
+		-context C	GL context of the headless views, glfw (default, a hidden window), egl (surfaceless, no
+				window system needed) or osmesa (Mesa offscreen, no window system or GPU needed); egl and
+				osmesa need a build with STL2PNG_EGL or STL2PNG_OSMESA, builds without STL2PNG_GLFW default
+				to them
+		-software	render with Mesa's multithreaded llvmpipe driver on -threads threads, the context defaults to
+				egl or osmesa when built in
+		-renderer R	what draws the views, gl (default), raster (the built in tiled software rasterizer on
+				-threads threads, no GL needed) or raycast (built in ray casting through a bounding volume
+				hierarchy on -threads threads, no GL needed, for models with far more triangles than pixels)
+		-verify		with -renderer raster or raycast, also draw the views with the GL and report how far they
+				differ, failing files with more than 1% of the pixels more than 8 levels apart in a channel
+		-shading S	how the GL shades the views, forward (default, every fragment as it is drawn), visibility (a
+				prepass writes the triangle of each pixel, then each covered pixel is shaded once) or prepass
+				(a depth only prepass, then the fragments with the nearest depth); the last two are for models
+				with a lot of overdraw and draw a view at a time
+		-passtimes	report the GPU time of the prepass and shading pass of each file, from GL timer queries
 )",
                stdout);
 }
@@ -370,6 +159,11 @@ int main(int argc, const char** argv) {
 
     vector<string> input;
     vector<string> options;
+    map<string, string> option_values;
+    // options followed by a value
+    const vector<string> value_options = {"threads", "blocksize", "weldeps", "crease",  "list",     "out",
+                                          "loaders", "encoders",  "pbos",    "png",     "color",    "format",
+                                          "atlas",   "size",      "depth",   "context", "renderer", "shading"};
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
 
@@ -379,21 +173,218 @@ int main(int argc, const char** argv) {
             // option
             options.emplace_back(arg.substr(1));
             std::transform(std::begin(options.back()), std::end(options.back()), std::begin(options.back()),
-                           std::tolower);
+                           [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+            const auto& name = options.back();
+            if (std::find(std::begin(value_options), std::end(value_options), name) != std::end(value_options)) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "Option -%s needs a value\n", name.c_str());
+                    print_usage();
+                    return 1;
+                }
+                option_values[name] = argv[++i];
+            }
         } else {
             // file
             input.emplace_back(arg);
         }
     }
 
+    auto has_option = [&options](const char* name) {
+        return std::find(std::begin(options), std::end(options), name) != std::end(options);
+    };
+    if (has_option("list")) {
+        const string& list = option_values["list"];
+        bool listed = false;
+        if (list == "-") {
+            listed = read_file_list(std::cin, input);
+        } else if (std::ifstream fs = std::ifstream(list)) {
+            listed = read_file_list(fs, input);
+        }
+        if (!listed) {
+            fprintf(stderr, "Failed to read file list \"%s\"\n", list.c_str());
+            return 1;
+        }
+    }
     if (input.empty()) {
         fprintf(stderr, "No STL file to process... \n");
         print_usage();
         return 1;
     }
-    bool window = std::find(std::begin(options), std::end(options), "window") != std::end(options);
+    RenderOptions opts;
+    opts.m_windowed = has_option("window");
+    opts.m_mmap = !has_option("nommap");
+    if (has_option("threads")) {
+        int threads = std::atoi(option_values["threads"].c_str());
+        if (threads < 1) {
+            fprintf(stderr, "Invalid thread count \"%s\"\n", option_values["threads"].c_str());
+            return 1;
+        }
+        opts.m_threads = static_cast<unsigned>(threads);
+    }
+    for (auto stage : {std::make_pair("loaders", &opts.m_loaders), std::make_pair("encoders", &opts.m_encoders)}) {
+        if (has_option(stage.first)) {
+            int threads = std::atoi(option_values[stage.first].c_str());
+            if (threads < 1) {
+                fprintf(stderr, "Invalid thread count \"%s\"\n", option_values[stage.first].c_str());
+                return 1;
+            }
+            *stage.second = static_cast<unsigned>(threads);
+        }
+    }
+    if (has_option("pbos")) {
+        int buffers = std::atoi(option_values["pbos"].c_str());
+        if (buffers < 0) {
+            fprintf(stderr, "Invalid buffer count \"%s\"\n", option_values["pbos"].c_str());
+            return 1;
+        }
+        opts.m_readback_buffers = static_cast<unsigned>(buffers);
+    }
+    if (has_option("png")) {
+        const std::map<string, Graphics::PNGEncoder> encoders = {{"stb", Graphics::PNGEncoder::Stb},
+                                                                 {"fast", Graphics::PNGEncoder::Fast},
+                                                                 {"balanced", Graphics::PNGEncoder::Balanced},
+                                                                 {"parallel", Graphics::PNGEncoder::Parallel}};
+        auto encoder = encoders.find(option_values["png"]);
+        if (encoder == encoders.end()) {
+            fprintf(stderr, "Unknown PNG encoder \"%s\"\n", option_values["png"].c_str());
+            return 1;
+        }
+        opts.m_png = encoder->second;
+    }
+    if (has_option("color")) {
+        const std::map<string, Graphics::ColorFormat> formats = {{"auto", Graphics::ColorFormat::Auto},
+                                                                 {"rgba", Graphics::ColorFormat::RGBA},
+                                                                 {"rgb", Graphics::ColorFormat::RGB},
+                                                                 {"gray", Graphics::ColorFormat::Gray},
+                                                                 {"palette", Graphics::ColorFormat::Palette}};
+        auto format = formats.find(option_values["color"]);
+        if (format == formats.end()) {
+            fprintf(stderr, "Unknown color format \"%s\"\n", option_values["color"].c_str());
+            return 1;
+        }
+        opts.m_color = format->second;
+    }
+    if (has_option("format")) {
+        const std::map<string, Graphics::ImageFormat> formats = {
+            {"png", Graphics::ImageFormat::PNG}, {"qoi", Graphics::ImageFormat::QOI},
+            {"ppm", Graphics::ImageFormat::PPM}, {"pam", Graphics::ImageFormat::PAM},
+            {"raw", Graphics::ImageFormat::Raw}, {"webp", Graphics::ImageFormat::WebP}};
+        auto format = formats.find(option_values["format"]);
+        if (format == formats.end()) {
+            fprintf(stderr, "Unknown image format \"%s\"\n", option_values["format"].c_str());
+            return 1;
+        }
+        opts.m_format = format->second;
+    }
+    if (has_option("atlas")) {
+        if (parse_size(option_values["atlas"], opts.m_atlas_tile_width, opts.m_atlas_tile_height) == false) {
+            fprintf(stderr, "Invalid atlas tile size \"%s\"\n", option_values["atlas"].c_str());
+            return 1;
+        }
+    }
+    if (has_option("size")) {
+        if (parse_size(option_values["size"], opts.m_width, opts.m_height) == false) {
+            fprintf(stderr, "Invalid framebuffer size \"%s\"\n", option_values["size"].c_str());
+            return 1;
+        }
+    }
+    if (has_option("depth")) {
+        const std::map<string, Graphics::DepthFormat> formats = {{"16", Graphics::DepthFormat::Depth16},
+                                                                 {"24", Graphics::DepthFormat::Depth24},
+                                                                 {"32f", Graphics::DepthFormat::Depth32F}};
+        auto format = formats.find(option_values["depth"]);
+        if (format == formats.end()) {
+            fprintf(stderr, "Unknown depth format \"%s\"\n", option_values["depth"].c_str());
+            return 1;
+        }
+        opts.m_depth = format->second;
+    }
+    opts.m_software_gl = has_option("software");
+    if (has_option("context")) {
+        const std::map<string, Graphics::ContextBackend> backends = {{"glfw", Graphics::ContextBackend::GLFW},
+                                                                     {"egl", Graphics::ContextBackend::EGL},
+                                                                     {"osmesa", Graphics::ContextBackend::OSMesa}};
+        auto backend = backends.find(option_values["context"]);
+        if (backend == backends.end()) {
+            fprintf(stderr, "Unknown context \"%s\"\n", option_values["context"].c_str());
+            return 1;
+        }
+        opts.m_context = backend->second;
+    } else if (opts.m_software_gl || !Graphics::context_available(Graphics::ContextBackend::GLFW)) {
+        // software rendering is for machines without a window system, as are builds without GLFW
+        for (auto backend : {Graphics::ContextBackend::EGL, Graphics::ContextBackend::OSMesa}) {
+            if (Graphics::context_available(backend)) {
+                opts.m_context = backend;
+                break;
+            }
+        }
+    }
+    if (has_option("renderer")) {
+        const std::map<string, Graphics::RendererBackend> renderers = {{"gl", Graphics::RendererBackend::GL},
+                                                                       {"raster", Graphics::RendererBackend::Raster},
+                                                                       {"raycast", Graphics::RendererBackend::Raycast}};
+        auto renderer = renderers.find(option_values["renderer"]);
+        if (renderer == renderers.end()) {
+            fprintf(stderr, "Unknown renderer \"%s\"\n", option_values["renderer"].c_str());
+            return 1;
+        }
+        opts.m_renderer = renderer->second;
+    }
+    if (has_option("shading")) {
+        const std::map<string, Graphics::ShadingMode> modes = {{"forward", Graphics::ShadingMode::Forward},
+                                                               {"visibility", Graphics::ShadingMode::Visibility},
+                                                               {"prepass", Graphics::ShadingMode::Prepass}};
+        auto mode = modes.find(option_values["shading"]);
+        if (mode == modes.end()) {
+            fprintf(stderr, "Unknown shading \"%s\"\n", option_values["shading"].c_str());
+            return 1;
+        }
+        opts.m_shading = mode->second;
+    }
+    opts.m_pass_times = has_option("passtimes");
+    opts.m_verify = has_option("verify");
+    if (opts.m_verify && opts.m_renderer == Graphics::RendererBackend::GL) {
+        fputs("-verify needs -renderer raster or raycast\n", stderr);
+        return 1;
+    }
+    // the window shows what the GL draws
+    if (opts.m_windowed && opts.m_renderer != Graphics::RendererBackend::GL) {
+        fputs("-window draws with the GL, it cannot be used with -renderer raster or raycast\n", stderr);
+        return 1;
+    }
+    opts.m_multiview = has_option("multiview");
+    opts.m_stream = has_option("stream");
+    if (has_option("blocksize")) {
+        long long block = std::atoll(option_values["blocksize"].c_str());
+        if (block < 1) {
+            fprintf(stderr, "Invalid block size \"%s\"\n", option_values["blocksize"].c_str());
+            return 1;
+        }
+        opts.m_block_facets = static_cast<size_t>(block);
+    }
+    opts.m_weld_options.m_smooth = has_option("smooth");
+    opts.m_optimize = has_option("optimize");
+    opts.m_compact = has_option("compact");
+    opts.m_weld = has_option("weld") || has_option("weldeps") || opts.m_weld_options.m_smooth || opts.m_optimize;
+    if (has_option("weldeps")) {
+        opts.m_weld_options.m_epsilon = static_cast<float>(std::atof(option_values["weldeps"].c_str()));
+    }
+    if (has_option("crease")) {
+        opts.m_weld_options.m_crease_angle = static_cast<float>(std::atof(option_values["crease"].c_str()));
+    }
     try {
-        return render_stl(input.front(), window);
+        ThreadPool pool(opts.m_threads);
+        if (opts.m_software_gl) {
+            Graphics::use_software_gl(opts.m_threads);
+        }
+        if (opts.m_windowed) {
+            if (input.size() > 1) {
+                fputs("Only the first file is shown in a window\n", stderr);
+            }
+            return show_stl(input.front(), opts, pool);
+        }
+        const bool batch = input.size() > 1 || has_option("list");
+        return render_pipelined(input, output_dirs(input, option_values["out"], batch), opts, pool);
     } catch (std::exception& e) {
         fprintf(stderr, "Unexpected error: %s", e.what());
         return -1;
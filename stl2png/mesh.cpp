@@ -0,0 +1,355 @@
+#include "mesh.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+using Graphics::Vert;
+
+inline uint32_t float_bits(float f) {
+    // +0 and -0 weld together
+    f += 0.f;
+    uint32_t u;
+    std::memcpy(&u, &f, 4);
+    return u;
+}
+
+inline uint32_t hash_combine(uint32_t h, uint32_t v) {
+    h ^= v + 0x9e3779b9u + (h << 6) + (h >> 2);
+    return h;
+}
+
+inline uint32_t finalize(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+struct PositionKey {
+    uint32_t m_x, m_y, m_z;
+    bool operator==(const PositionKey& o) const { return m_x == o.m_x && m_y == o.m_y && m_z == o.m_z; }
+    uint32_t hash() const { return finalize(hash_combine(hash_combine(m_x, m_y), m_z)); }
+};
+
+struct VertexKey {
+    uint32_t m_position;
+    uint32_t m_nx, m_ny, m_nz;
+    bool operator==(const VertexKey& o) const {
+        return m_position == o.m_position && m_nx == o.m_nx && m_ny == o.m_ny && m_nz == o.m_nz;
+    }
+    uint32_t hash() const {
+        return finalize(hash_combine(hash_combine(hash_combine(m_position, m_nx), m_ny), m_nz));
+    }
+};
+
+// Open addressing hash set of keys stored in a vector, returns the key index. Sized up front for a known maximum
+// number of keys so it never rehashes.
+template <typename Key>
+class KeyTable {
+   public:
+    explicit KeyTable(size_t max_keys) {
+        size_t slots = 16;
+        while (slots < max_keys * 2) {
+            slots *= 2;
+        }
+        m_slots.assign(slots, EMPTY);
+        m_mask = slots - 1;
+        m_keys.reserve(max_keys);
+    }
+
+    uint32_t insert(const Key& key) {
+        for (size_t slot = key.hash() & m_mask;; slot = (slot + 1) & m_mask) {
+            uint32_t index = m_slots[slot];
+            if (index == EMPTY) {
+                index = static_cast<uint32_t>(m_keys.size());
+                m_slots[slot] = index;
+                m_keys.push_back(key);
+                return index;
+            }
+            if (m_keys[index] == key) {
+                return index;
+            }
+        }
+    }
+
+    size_t size() const { return m_keys.size(); }
+
+   private:
+    static constexpr uint32_t EMPTY = 0xffffffffu;
+    std::vector<uint32_t> m_slots;
+    std::vector<Key> m_keys;
+    size_t m_mask = 0;
+};
+
+PositionKey position_key(const Vert& v, float inv_epsilon) {
+    if (inv_epsilon == 0.f) {
+        return PositionKey{float_bits(v.x), float_bits(v.y), float_bits(v.z)};
+    }
+    auto cell = [inv_epsilon](float f) {
+        return static_cast<uint32_t>(static_cast<int32_t>(std::floor(f * inv_epsilon)));
+    };
+    return PositionKey{cell(v.x), cell(v.y), cell(v.z)};
+}
+
+// Area weighted average of the normals of faces around each corner's position, leaving out faces past the crease.
+std::vector<glm::vec3> smooth_normals(const std::vector<Vert>& triangles, const std::vector<uint32_t>& position_of,
+                                      size_t positions, float crease_angle) {
+    using namespace glm;
+    const size_t corners = triangles.size();
+    const float cos_crease = std::cos(crease_angle * 3.14159265f / 180.f);
+
+    // corners around each position, CSR layout
+    std::vector<uint32_t> first(positions + 1, 0);
+    for (size_t c = 0; c < corners; ++c) {
+        ++first[position_of[c] + 1];
+    }
+    for (size_t p = 0; p < positions; ++p) {
+        first[p + 1] += first[p];
+    }
+    std::vector<uint32_t> around(corners);
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t c = 0; c < corners; ++c) {
+        around[fill[position_of[c]]++] = static_cast<uint32_t>(c);
+    }
+
+    // facet normal and area weight of each face
+    std::vector<vec3> face_normal(corners / 3);
+    std::vector<float> face_area(corners / 3);
+    for (size_t f = 0; f < face_normal.size(); ++f) {
+        const Vert* t = &triangles[3 * f];
+        face_normal[f] = vec3(t->nx, t->ny, t->nz);
+        vec3 e1 = vec3(t[1].x - t[0].x, t[1].y - t[0].y, t[1].z - t[0].z);
+        vec3 e2 = vec3(t[2].x - t[0].x, t[2].y - t[0].y, t[2].z - t[0].z);
+        face_area[f] = length(cross(e1, e2));
+    }
+
+    std::vector<vec3> normals(corners);
+    for (size_t c = 0; c < corners; ++c) {
+        const vec3 fn = face_normal[c / 3];
+        vec3 n(0.f);
+        const uint32_t p = position_of[c];
+        for (uint32_t i = first[p]; i < first[p + 1]; ++i) {
+            const size_t other = around[i] / 3;
+            if (dot(fn, face_normal[other]) >= cos_crease) {
+                n += face_normal[other] * face_area[other];
+            }
+        }
+        const float len = length(n);
+        normals[c] = len > 0.f ? n / len : fn;
+    }
+    return normals;
+}
+
+// Forsyth scoring, "Linear-Speed Vertex Cache Optimisation"
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+const float FORSYTH_VALENCE_SCALE = 2.0f;
+const float FORSYTH_VALENCE_POWER = 0.5f;
+
+float forsyth_vertex_score(int cache_position, uint32_t remaining_triangles) {
+    if (remaining_triangles == 0) {
+        // nothing left to draw with this vertex
+        return -1.f;
+    }
+    float score = 0.f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // used by the last triangle, fixed score so it does not favour its own vertices
+            score = FORSYTH_LAST_TRI_SCORE;
+        } else {
+            const float scaler = 1.f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.f - (cache_position - 3) * scaler, FORSYTH_DECAY_POWER);
+        }
+    }
+    // boost vertices with few triangles left so they are finished off
+    score += FORSYTH_VALENCE_SCALE * std::pow(float(remaining_triangles), -FORSYTH_VALENCE_POWER);
+    return score;
+}
+}  // namespace
+
+namespace Mesh {
+IndexedMesh weld(const std::vector<Graphics::Vert>& triangles, const WeldOptions& opts) {
+    const size_t corners = triangles.size();
+    const float inv_epsilon = opts.m_epsilon > 0.f ? 1.f / opts.m_epsilon : 0.f;
+
+    // welded position of each corner, and the first corner at each position which decides where it is
+    std::vector<uint32_t> position_of(corners);
+    std::vector<uint32_t> position_corner;
+    {
+        KeyTable<PositionKey> table(corners);
+        for (size_t c = 0; c < corners; ++c) {
+            position_of[c] = table.insert(position_key(triangles[c], inv_epsilon));
+            if (position_of[c] == position_corner.size()) {
+                position_corner.push_back(static_cast<uint32_t>(c));
+            }
+        }
+    }
+    const size_t positions = position_corner.size();
+
+    std::vector<glm::vec3> normals;
+    if (opts.m_smooth) {
+        normals = smooth_normals(triangles, position_of, positions, opts.m_crease_angle);
+    }
+
+    IndexedMesh mesh;
+    mesh.m_indices.resize(corners);
+    KeyTable<VertexKey> table(corners);
+    for (size_t c = 0; c < corners; ++c) {
+        const Vert& v = triangles[c];
+        const glm::vec3 n = opts.m_smooth ? normals[c] : glm::vec3(v.nx, v.ny, v.nz);
+        const VertexKey key{position_of[c], float_bits(n.x), float_bits(n.y), float_bits(n.z)};
+        const uint32_t index = table.insert(key);
+        if (index == mesh.m_vertices.size()) {
+            const Vert& p = triangles[position_corner[position_of[c]]];
+            mesh.m_vertices.emplace_back(glm::vec3(p.x, p.y, p.z), n);
+        }
+        mesh.m_indices[c] = index;
+    }
+    return mesh;
+}
+
+float acmr(const std::vector<uint32_t>& indices, size_t vertex_count, unsigned cache_size) {
+    if (indices.empty()) {
+        return 0.f;
+    }
+    // time stamp of when each vertex entered the FIFO, it is still cached if fewer than cache_size misses since
+    std::vector<uint64_t> entered(vertex_count, 0);
+    uint64_t misses = 0;
+    for (uint32_t i : indices) {
+        if (entered[i] == 0 || misses - entered[i] >= cache_size) {
+            ++misses;
+            entered[i] = misses;
+        }
+    }
+    return float(misses) / float(indices.size() / 3);
+}
+
+void optimize_vertex_cache(IndexedMesh& mesh) {
+    const size_t triangles = mesh.m_indices.size() / 3;
+    const size_t vertices = mesh.m_vertices.size();
+    if (triangles == 0) {
+        return;
+    }
+    const std::vector<uint32_t>& indices = mesh.m_indices;
+
+    // triangles using each vertex, CSR layout. remaining[v] counts the ones not yet emitted which are kept first
+    std::vector<uint32_t> first(vertices + 1, 0);
+    for (uint32_t i : indices) {
+        ++first[i + 1];
+    }
+    for (size_t v = 0; v < vertices; ++v) {
+        first[v + 1] += first[v];
+    }
+    std::vector<uint32_t> vertex_triangles(indices.size());
+    std::vector<uint32_t> remaining(vertices, 0);
+    for (size_t t = 0; t < triangles; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[3 * t + k];
+            vertex_triangles[first[v] + remaining[v]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int> cache_position(vertices, -1);
+    std::vector<float> vertex_score(vertices);
+    for (size_t v = 0; v < vertices; ++v) {
+        vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangles);
+    std::vector<bool> emitted(triangles, false);
+    for (size_t t = 0; t < triangles; ++t) {
+        triangle_score[t] =
+            vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+    }
+
+    std::vector<uint32_t> cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    std::vector<uint32_t> next_cache;
+    next_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+
+    size_t best = 0;
+    for (size_t t = 1; t < triangles; ++t) {
+        if (triangle_score[t] > triangle_score[best]) best = t;
+    }
+    // triangles before this are all emitted, used when the cache has nothing left to offer
+    size_t scan = 0;
+    for (size_t emitted_count = 0; emitted_count < triangles; ++emitted_count) {
+        const uint32_t* tri = &indices[3 * best];
+        emitted[best] = true;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            out.push_back(v);
+            // move the triangle past the remaining ones of the vertex
+            uint32_t* list = &vertex_triangles[first[v]];
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                if (list[i] == best) {
+                    std::swap(list[i], list[remaining[v] - 1]);
+                    break;
+                }
+            }
+            --remaining[v];
+        }
+
+        // LRU cache with the triangle's vertices in front
+        next_cache.assign(tri, tri + 3);
+        for (uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < next_cache.size(); ++i) {
+            const uint32_t v = next_cache[i];
+            cache_position[v] = i < size_t(FORSYTH_CACHE_SIZE) ? int(i) : -1;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], remaining[v]);
+        }
+        // rescore the triangles touching the cache, including vertices just evicted, and pick the best
+        float best_score = -1.f;
+        size_t next_best = triangles;
+        for (uint32_t v : next_cache) {
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                const uint32_t t = vertex_triangles[first[v] + i];
+                const float score = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] +
+                                    vertex_score[indices[3 * t + 2]];
+                triangle_score[t] = score;
+                if (score > best_score) {
+                    best_score = score;
+                    next_best = t;
+                }
+            }
+        }
+        if (next_cache.size() > size_t(FORSYTH_CACHE_SIZE)) {
+            next_cache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(next_cache);
+
+        if (next_best == triangles) {
+            // nothing connected to the cache, continue with the next triangle not yet emitted
+            while (scan < triangles && emitted[scan]) {
+                ++scan;
+            }
+            next_best = scan;
+        }
+        best = next_best;
+    }
+    mesh.m_indices.swap(out);
+}
+
+void optimize_vertex_fetch(IndexedMesh& mesh) {
+    const uint32_t unused = 0xffffffffu;
+    std::vector<uint32_t> remap(mesh.m_vertices.size(), unused);
+    std::vector<Graphics::Vert> vertices;
+    vertices.reserve(mesh.m_vertices.size());
+    for (uint32_t& i : mesh.m_indices) {
+        if (remap[i] == unused) {
+            remap[i] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.m_vertices[i]);
+        }
+        i = remap[i];
+    }
+    mesh.m_vertices.swap(vertices);
+}
+}  // namespace Mesh
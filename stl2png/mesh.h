@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "vertex_buffer.h"
+
+namespace Mesh {
+
+// A vertex buffer with an index buffer, three indices per triangle.
+struct IndexedMesh {
+    std::vector<Graphics::Vert> m_vertices;
+    std::vector<uint32_t> m_indices;
+
+    // all indices fit a GL_UNSIGNED_SHORT index buffer
+    bool fits_16bit() const { return m_vertices.size() <= 0xffff; }
+};
+
+struct WeldOptions {
+    // positions closer than this in every axis (same quantisation cell) are merged, 0 merges only exact matches
+    float m_epsilon = 0.f;
+    // average the facet normals of faces sharing a position instead of keeping flat facet normals
+    bool m_smooth = false;
+    // faces meeting at a larger angle than this keep separate normals when smoothing, in degrees
+    float m_crease_angle = 30.f;
+};
+
+// Welds a triangle soup (3 vertices per facet, as built by fill_vertex_buffer) into an indexed mesh. Positions are
+// deduplicated with a hash table, a vertex is shared by corners with the same position and normal. Vertices are
+// numbered in order of first use.
+IndexedMesh weld(const std::vector<Graphics::Vert>& triangles, const WeldOptions& opts);
+
+// Average cache miss ratio, transformed vertices per triangle, simulating a FIFO post-transform cache.
+float acmr(const std::vector<uint32_t>& indices, size_t vertex_count, unsigned cache_size = 16);
+
+// Reorders the triangles for the post-transform vertex cache, Tom Forsyth's linear-speed vertex cache optimisation.
+void optimize_vertex_cache(IndexedMesh& mesh);
+
+// Reorders the vertices in order of first use by the index buffer so vertex fetch walks memory linearly.
+void optimize_vertex_fetch(IndexedMesh& mesh);
+}  // namespace Mesh
@@ -0,0 +1,155 @@
+#include "model.h"
+#include <stdint.h>
+#include <cstdio>
+
+namespace Graphics {
+
+namespace {
+// Streams the facets of the STL file in blocks into the bound GL_ARRAY_BUFFER, pre-sized from the facet count. Host
+// memory is bounded by the block size. ASCII files can not be streamed and are loaded whole.
+bool stream_stl(const std::string& stl, const RenderOptions& opts, ThreadPool& pool, GLModel& uploaded) {
+    STL::FacetStream stream;
+    switch (stream.open(stl)) {
+        case STL::Format::ASCII: {
+            RenderOptions whole = opts;
+            whole.m_stream = false;
+            LoadedModel model;
+            if (load_model(stl, whole, pool, model) == false) {
+                return false;
+            }
+            model.wait();
+            glBufferData(GL_ARRAY_BUFFER, sizeof(Vert) * model.m_vertices.size(), model.m_vertices.data(),
+                         GL_STATIC_DRAW);
+            uploaded.m_count = static_cast<GLsizei>(model.m_vertices.size());
+            uploaded.m_min = model.m_min;
+            uploaded.m_max = model.m_max;
+            uploaded.m_center = model.m_center;
+            return true;
+        }
+        case STL::Format::Invalid:
+            return false;
+        case STL::Format::Binary:
+            break;
+    }
+
+    const size_t count = stream.size();
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vert) * 3 * count, nullptr, GL_STATIC_DRAW);
+    std::vector<STL::PackedFacet> block;
+    std::vector<Vert> vertices(opts.m_block_facets * 3);
+    Bounds bounds;
+    size_t done = 0;
+    while (size_t n = stream.read(block, opts.m_block_facets)) {
+        Bounds block_bounds;
+        fill_vertex_range(STL::FacetView(block.data(), n), vertices.data(), pool, &block_bounds);
+        bounds.merge(block_bounds);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vert) * 3 * done, sizeof(Vert) * 3 * n, vertices.data());
+        done += n;
+    }
+    if (done != count) {
+        return false;
+    }
+    uploaded.m_min = bounds.m_min;
+    uploaded.m_max = bounds.m_max;
+    uploaded.m_center = bounds.centroid();
+    uploaded.m_count = static_cast<GLsizei>(3 * count);
+    return true;
+}
+
+// Uploads the indices of a welded mesh into the bound element buffer, using 16-bit indices when all vertices can be
+// addressed with them
+GLenum upload_indices(const Mesh::IndexedMesh& mesh) {
+    if (mesh.fits_16bit()) {
+        std::vector<uint16_t> indices(mesh.m_indices.begin(), mesh.m_indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+        return GL_UNSIGNED_SHORT;
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * mesh.m_indices.size(), mesh.m_indices.data(),
+                 GL_STATIC_DRAW);
+    return GL_UNSIGNED_INT;
+}
+}  // namespace
+
+bool load_model(const std::string& stl, const RenderOptions& opts, ThreadPool& pool, LoadedModel& model) {
+    model.m_file = stl;
+    if (opts.m_stream) {
+        // read once the GL buffer exists
+        model.m_stream = true;
+        return true;
+    }
+    if (opts.m_mmap) {
+        model.m_mapped = STL::map(stl);
+        if (!model.m_mapped) {
+            return false;
+        }
+        // The bounds are computed up front and the vertices converted in the background, so the GL side can be set
+        // up meanwhile. The facets and vertex storage stay in place when the model is moved.
+        const STL::FacetView facets = model.m_mapped->facets();
+        Bounds bounds = compute_bounds(facets, pool);
+        model.m_min = bounds.m_min;
+        model.m_max = bounds.m_max;
+        model.m_center = bounds.centroid();
+        model.m_vertices.resize(facets.size() * 3);
+        Vert* out = model.m_vertices.data();
+        model.m_converting = std::async(std::launch::async, [facets, out, &pool]() {
+            fill_vertex_range(facets, out, pool);
+        });
+        return true;
+    }
+    if (auto data = STL::read(stl)) {
+        fill_vertex_buffer(*data, model.m_vertices, model.m_min, model.m_max, model.m_center, pool);
+        return true;
+    }
+    return false;
+}
+
+Mesh::IndexedMesh weld_model(const std::vector<Vert>& vertices, const RenderOptions& opts) {
+    Mesh::IndexedMesh mesh = Mesh::weld(vertices, opts.m_weld_options);
+    if (opts.m_optimize) {
+        const float before = Mesh::acmr(mesh.m_indices, mesh.m_vertices.size());
+        Mesh::optimize_vertex_cache(mesh);
+        Mesh::optimize_vertex_fetch(mesh);
+        const float after = Mesh::acmr(mesh.m_indices, mesh.m_vertices.size());
+        printf("Welded %zu vertices to %zu, ACMR %.3f before, %.3f after optimisation\n", vertices.size(),
+               mesh.m_vertices.size(), before, after);
+    }
+    return mesh;
+}
+
+glm::mat4 GLModel::dequantization() const {
+    return m_compact ? dequantization_matrix(m_min, m_max) : glm::mat4(1.f);
+}
+
+bool upload_model(LoadedModel& model, const RenderOptions& opts, ThreadPool& pool, GLModel& uploaded) {
+    uploaded = GLModel();
+    if (model.m_stream) {
+        // never compact, quantising needs the bounds before the upload and streaming only knows them at the end
+        return stream_stl(model.m_file, opts, pool, uploaded);
+    }
+    model.wait();
+    uploaded.m_min = model.m_min;
+    uploaded.m_max = model.m_max;
+    uploaded.m_center = model.m_center;
+    std::vector<Vert>& vertices = model.m_vertices;
+    if (opts.m_weld) {
+        Mesh::IndexedMesh mesh = weld_model(vertices, opts);
+        uploaded.m_index_type = upload_indices(mesh);
+        uploaded.m_count = static_cast<GLsizei>(mesh.m_indices.size());
+        // the welded vertices are uploaded instead
+        vertices.swap(mesh.m_vertices);
+    } else {
+        uploaded.m_count = static_cast<GLsizei>(vertices.size());
+    }
+    uploaded.m_compact = opts.m_compact;
+    if (uploaded.m_compact) {
+        std::vector<CompactVert> packed;
+        quantize_vertices(vertices, uploaded.m_min, uploaded.m_max, packed, pool);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(CompactVert) * packed.size(), packed.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vert) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+    }
+    // the GL keeps its own copy
+    std::vector<Vert>().swap(vertices);
+    model.m_mapped.reset();
+    return true;
+}
+}  // namespace Graphics
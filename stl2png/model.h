@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <future>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "options.h"
+#include "stl.h"
+#include "thread_pool.h"
+#include "vertex_buffer.h"
+
+namespace Graphics {
+
+// A model loaded on the CPU and ready to upload. When mapped the bounds are known up front and the vertices are
+// converted in the background, wait() before using them. Streamed models are only read when uploading.
+struct LoadedModel {
+    std::string m_file;
+    bool m_stream = false;
+    std::optional<STL::MappedSTL> m_mapped;
+    std::vector<Vert> m_vertices;
+    glm::vec3 m_min, m_max, m_center;
+    // declared last so it is waited for before the buffers it writes are destroyed
+    std::future<void> m_converting;
+
+    void wait() {
+        if (m_converting.valid()) {
+            m_converting.get();
+        }
+    }
+};
+
+// Loads the STL file, either from a memory mapping of the file or by reading a copy of all facets first.
+bool load_model(const std::string& stl, const RenderOptions& opts, ThreadPool& pool, LoadedModel& model);
+
+// Welds the vertices of the model as the options ask, optimising the mesh for the vertex caches with -optimize.
+Mesh::IndexedMesh weld_model(const std::vector<Vert>& vertices, const RenderOptions& opts);
+
+// What was uploaded for a model and how to draw it.
+struct GLModel {
+    // vertices, or indices when drawing indexed
+    GLsizei m_count = 0;
+    // GL_NONE draws arrays, otherwise the type of the element buffer
+    GLenum m_index_type = GL_NONE;
+    // vertices are CompactVert instead of Vert
+    bool m_compact = false;
+    glm::vec3 m_min, m_max, m_center;
+
+    // maps the attribute positions to model space, quantised positions are relative to the bounds
+    glm::mat4 dequantization() const;
+};
+
+// Uploads the model into the bound GL_ARRAY_BUFFER, and the bound GL_ELEMENT_ARRAY_BUFFER when welding, replacing
+// their contents. Streamed models are read from the file in blocks.
+bool upload_model(LoadedModel& model, const RenderOptions& opts, ThreadPool& pool, GLModel& uploaded);
+}  // namespace Graphics
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include "context.h"
+#include "framebuffer.h"
+#include "image.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+namespace Graphics {
+// what draws the views
+enum class RendererBackend {
+    // the GL, with the context backend of the options
+    GL,
+    // the tiled software rasterizer, for machines without a GL driver
+    Raster,
+    // the packet ray caster, for machines without a GL driver and models with many more triangles than pixels
+    Raycast,
+};
+
+// how the GL shades the views
+enum class ShadingMode {
+    // every fragment passing the depth test as it is drawn
+    Forward,
+    // a prepass writes the triangle of each pixel into a visibility buffer, then each covered pixel is shaded once
+    Visibility,
+    // a depth only prepass, then every fragment with the nearest depth, GL_EQUAL
+    Prepass,
+};
+}  // namespace Graphics
+
+// Command line settings shared by the loading and rendering code.
+struct RenderOptions {
+    bool m_windowed = false;
+    bool m_mmap = true;
+    unsigned m_threads = ThreadPool::hardware_threads();
+    bool m_stream = false;
+    size_t m_block_facets = 64 * 1024;
+    bool m_weld = false;
+    Mesh::WeldOptions m_weld_options;
+    bool m_optimize = false;
+    bool m_compact = false;
+    // threads parsing the next files and threads compressing images in batches
+    unsigned m_loaders = 1;
+    unsigned m_encoders = ThreadPool::hardware_threads();
+    // pixel pack buffers reading back views asynchronously, 0 reads synchronously
+    unsigned m_readback_buffers = 3;
+    Graphics::PNGEncoder m_png = Graphics::PNGEncoder::Stb;
+    // RGBA as before -color, so the images stay byte for byte the same unless asked; the views are opaque, so the other
+    // formats read back only RGB
+    Graphics::ColorFormat m_color = Graphics::ColorFormat::RGBA;
+    Graphics::ImageFormat m_format = Graphics::ImageFormat::PNG;
+    // tile size of a single atlas image holding all views, 0 writes an image per view
+    int m_atlas_tile_width = 0;
+    int m_atlas_tile_height = 0;
+    // all views drawn in a single pass by a geometry shader
+    bool m_multiview = false;
+    // offscreen framebuffer the headless views are drawn in
+    int m_width = 1920;
+    int m_height = 1080;
+    Graphics::DepthFormat m_depth = Graphics::DepthFormat::Depth24;
+    // the GL context headless views are drawn with, and whether Mesa is asked for its software rasterizer
+    Graphics::ContextBackend m_context = Graphics::ContextBackend::GLFW;
+    bool m_software_gl = false;
+    Graphics::RendererBackend m_renderer = Graphics::RendererBackend::GL;
+    Graphics::ShadingMode m_shading = Graphics::ShadingMode::Forward;
+    // GPU time of the passes reported per file
+    bool m_pass_times = false;
+    // the rasterized views are drawn with the GL as well and compared
+    bool m_verify = false;
+};
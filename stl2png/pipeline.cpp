@@ -0,0 +1,354 @@
+#include "pipeline.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "bounded_queue.h"
+#include "image.h"
+#include "model.h"
+#include "readback.h"
+#include "renderer.h"
+#include "shading.h"
+#include "software_renderer.h"
+
+namespace {
+// read back images waiting for the encoders, two models worth of views
+const size_t ENCODE_QUEUE_IMAGES = 14;
+
+struct LoadedFile {
+    size_t m_index = 0;
+    bool m_loaded = false;
+    Graphics::LoadedModel m_model;
+};
+
+struct EncodeJob {
+    size_t m_index = 0;
+    std::string m_path;
+    Graphics::Image m_image;
+    // hands the pixels back once written
+    std::function<void()> m_release;
+    // written along with the image when not empty
+    std::string m_sidecar_path;
+    std::string m_sidecar;
+};
+
+// JSON description of where the views are in an atlas image, rows counted in image memory order
+std::string atlas_json(const Graphics::AtlasLayout& layout, const std::array<Graphics::View, 7>& views,
+                       const std::string& image) {
+    std::string json = "{\n";
+    json += "  \"image\": \"" + image + "\",\n";
+    json += "  \"width\": " + std::to_string(layout.width()) + ",\n";
+    json += "  \"height\": " + std::to_string(layout.height()) + ",\n";
+    json += "  \"tile_width\": " + std::to_string(layout.m_tile_width) + ",\n";
+    json += "  \"tile_height\": " + std::to_string(layout.m_tile_height) + ",\n";
+    json += "  \"tiles\": [\n";
+    for (size_t v = 0; v < views.size(); ++v) {
+        json += "    {\"view\": \"" + views[v].m_viewName + "\", \"x\": " + std::to_string(layout.tile_x(v)) +
+                ", \"y\": " + std::to_string(layout.tile_y(v)) + "}" + (v + 1 < views.size() ? ",\n" : "\n");
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+bool write_text(const std::string& path, const std::string& text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && written;
+}
+}  // namespace
+
+int render_pipelined(const std::vector<std::string>& files, const std::vector<std::string>& dirs,
+                     const RenderOptions& opts, ThreadPool& pool) {
+    const size_t count = files.size();
+    // value initialised, none failed
+    std::vector<std::atomic<bool>> failed(count);
+    BoundedQueue<LoadedFile> loaded(opts.m_loaders);
+    BoundedQueue<EncodeJob> encoding(ENCODE_QUEUE_IMAGES);
+
+    // loaders take the next file until all are taken, the last one to finish closes the queue
+    std::atomic<size_t> next{0};
+    std::atomic<unsigned> loading{opts.m_loaders};
+    std::vector<std::thread> loaders;
+    for (unsigned t = 0; t < opts.m_loaders; ++t) {
+        loaders.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                LoadedFile file;
+                file.m_index = i;
+                try {
+                    file.m_loaded = Graphics::load_model(files[i], opts, pool, file.m_model);
+                    if (file.m_loaded) {
+                        // converted here rather than on the render thread
+                        file.m_model.wait();
+                    }
+                } catch (std::exception& e) {
+                    fprintf(stderr, "Unexpected error: %s\n", e.what());
+                    file.m_loaded = false;
+                }
+                if (loaded.push(std::move(file)) == false) {
+                    break;
+                }
+            }
+            if (--loading == 0) {
+                loaded.close();
+            }
+        });
+    }
+
+    const std::unique_ptr<Graphics::ImageEncoder> encoder = Graphics::make_encoder(opts.m_format, opts.m_png, &pool);
+    std::vector<std::thread> encoders;
+    for (unsigned t = 0; t < opts.m_encoders; ++t) {
+        encoders.emplace_back([&]() {
+            while (auto job = encoding.pop()) {
+                bool written = false;
+                try {
+                    Graphics::Image reduced;
+                    if (Graphics::reduce_colors(job->m_image, opts.m_color, reduced) &&
+                        encoder->accepts(reduced, opts.m_color)) {
+                        // the read back pixels are no longer needed
+                        if (job->m_release) {
+                            job->m_release();
+                            job->m_release = nullptr;
+                        }
+                        job->m_image = std::move(reduced);
+                    }
+                    written = encoder->write(job->m_image, job->m_path);
+                    if (written && !job->m_sidecar_path.empty() && !write_text(job->m_sidecar_path, job->m_sidecar)) {
+                        fprintf(stderr, "Failed to write \"%s\"\n", job->m_sidecar_path.c_str());
+                        written = false;
+                    }
+                } catch (std::exception& e) {
+                    fprintf(stderr, "Unexpected error: %s\n", e.what());
+                }
+                if (!written) {
+                    failed[job->m_index] = true;
+                }
+                if (job->m_release) {
+                    job->m_release();
+                }
+            }
+        });
+    }
+
+    // stops the loaders, lets the encoders drain the queue and waits for both
+    auto finish = [&]() {
+        loaded.close();
+        encoding.close();
+        for (auto& t : loaders) {
+            t.join();
+        }
+        for (auto& t : encoders) {
+            t.join();
+        }
+    };
+
+    // declared ahead of the render loop so the encoders are finished with mapped buffers before they go
+    Graphics::GLRenderer renderer;
+    Graphics::ReadbackRing ring;
+    const bool gl = opts.m_renderer == Graphics::RendererBackend::GL;
+    std::unique_ptr<Graphics::SoftwareRenderer> software;
+    if (!gl) {
+        software = Graphics::make_software_renderer(opts.m_renderer, pool);
+    }
+    const bool verify = !gl && opts.m_verify;
+    try {
+        if ((gl || verify) && (renderer.init(false, opts.m_context) == false ||
+                   renderer.resize_target(opts.m_width, opts.m_height, opts.m_depth) == false)) {
+            finish();
+            return -1;
+        }
+        if (gl && opts.m_readback_buffers > 0 && Graphics::ReadbackRing::supported()) {
+            ring.init(opts.m_readback_buffers);
+        }
+        bool multiview = gl && opts.m_multiview && renderer.init_multiview();
+        if (gl && opts.m_multiview && !multiview) {
+            fputs("Drawing the views one at a time instead\n", stderr);
+        }
+        if (gl && ((opts.m_shading == Graphics::ShadingMode::Visibility && renderer.init_visibility() == false) ||
+                   (opts.m_shading == Graphics::ShadingMode::Prepass && renderer.init_depth_prepass() == false))) {
+            fputs("Shading every fragment instead\n", stderr);
+        }
+        const bool pass_times = gl && opts.m_pass_times && renderer.time_passes();
+        if (verify) {
+            printf("Shading with %s\n", Shading::vector_instructions());
+        }
+        while (auto file = loaded.pop()) {
+            const size_t i = file->m_index;
+            bool uploaded = file->m_loaded && (gl ? renderer.upload(file->m_model, opts, pool)
+                                                  : software->upload(file->m_model, opts));
+            if (uploaded && verify) {
+                // uploads take the vertices, the GL gets them from loading the file again
+                Graphics::LoadedModel reference;
+                uploaded = Graphics::load_model(files[i], opts, pool, reference);
+                if (uploaded) {
+                    reference.wait();
+                    uploaded = renderer.upload(reference, opts, pool);
+                }
+            }
+            if (!uploaded) {
+                fprintf(stderr, "Failed to load \"%s\"\n", files[i].c_str());
+                failed[i] = true;
+                continue;
+            }
+            std::error_code error;
+            if (!dirs[i].empty()) {
+                std::filesystem::create_directories(dirs[i], error);
+            }
+            if (error) {
+                fprintf(stderr, "Failed to create directory \"%s\"\n", dirs[i].c_str());
+                failed[i] = true;
+                continue;
+            }
+            const auto& views = gl ? renderer.views() : software->views();
+            const int channels = Graphics::readback_channels(opts.m_color);
+            auto make_job = [&](const std::string& name, Graphics::Image image, std::function<void()> release) {
+                EncodeJob job;
+                job.m_index = i;
+                job.m_path = (std::filesystem::path(dirs[i]) / (name + "." + encoder->extension())).string();
+                job.m_image = std::move(image);
+                job.m_release = std::move(release);
+                return job;
+            };
+            auto queue_view = [&](size_t v, Graphics::Image image, std::function<void()> release) {
+                encoding.push(make_job("view_" + views[v].m_viewName, std::move(image), std::move(release)));
+            };
+            auto queue_atlas = [&](const Graphics::AtlasLayout& layout, Graphics::Image image,
+                                   std::function<void()> release) {
+                EncodeJob job = make_job("atlas", std::move(image), std::move(release));
+                job.m_sidecar_path = (std::filesystem::path(dirs[i]) / "atlas.json").string();
+                job.m_sidecar = atlas_json(layout, views, std::filesystem::path(job.m_path).filename().string());
+                encoding.push(std::move(job));
+            };
+            // reports how far a software image is from the GL's, false when too far
+            auto verified = [&](const char* name, const Graphics::Image& image, const Graphics::Image& reference) {
+                Graphics::ImageDifference difference;
+                if (Graphics::compare(image, reference, Graphics::VERIFY_TOLERANCE, difference) == false) {
+                    fprintf(stderr, "%s of \"%s\" differs in size from the GL\n", name, files[i].c_str());
+                    return false;
+                }
+                const double apart = double(difference.m_pixels) / (double(image.m_width) * image.m_height);
+                printf("%s of \"%s\": %.3f%% of the pixels apart from the GL by more than %d, at most %d, %.3f on "
+                       "average\n",
+                       name, files[i].c_str(), apart * 100.0, Graphics::VERIFY_TOLERANCE, difference.m_max,
+                       difference.m_mean);
+                return apart <= Graphics::VERIFY_PIXELS;
+            };
+            if (!gl) {
+                // drawn straight into the images the encoders take
+                if (opts.m_atlas_tile_width > 0) {
+                    const Graphics::AtlasLayout layout = Graphics::make_atlas_layout(
+                        views.size(), opts.m_atlas_tile_width, opts.m_atlas_tile_height);
+                    Graphics::Image image, reference;
+                    if (software->read_atlas(layout, channels, image) == false ||
+                        (verify && (renderer.read_atlas(layout, channels, reference) == false ||
+                                    verified("Atlas", image, reference) == false))) {
+                        failed[i] = true;
+                        continue;
+                    }
+                    queue_atlas(layout, std::move(image), nullptr);
+                    continue;
+                }
+                for (size_t v = 0; v < views.size(); ++v) {
+                    Graphics::Image image;
+                    if (software->read_view(views[v], opts.m_width, opts.m_height, channels, image) == false) {
+                        failed[i] = true;
+                        break;
+                    }
+                    if (verify && verified(("View " + views[v].m_viewName).c_str(), image,
+                                           renderer.read_view(views[v], channels)) == false) {
+                        failed[i] = true;
+                    }
+                    queue_view(v, std::move(image), nullptr);
+                }
+                continue;
+            }
+            if (opts.m_atlas_tile_width > 0) {
+                const Graphics::AtlasLayout layout =
+                    Graphics::make_atlas_layout(views.size(), opts.m_atlas_tile_width, opts.m_atlas_tile_height);
+                Graphics::Image image;
+                std::function<void()> release;
+                bool drawn = false;
+                if (ring.is_initialized()) {
+                    drawn = renderer.draw_atlas(layout);
+                    if (drawn) {
+                        // mapped right away, nothing else is drawn for this model meanwhile
+                        const size_t slot = ring.read(layout.width(), layout.height(), channels);
+                        image = ring.map(slot);
+                        release = [&ring, slot]() { ring.release(slot); };
+                    }
+                } else {
+                    drawn = renderer.read_atlas(layout, channels, image);
+                }
+                if (!drawn) {
+                    failed[i] = true;
+                    continue;
+                }
+                queue_atlas(layout, std::move(image), std::move(release));
+            } else {
+                // the views are either drawn in one pass into window sized tiles of the atlas framebuffer, or one at
+                // a time into the window, and then read back a view at a time
+                int width{0}, height{0};
+                renderer.framebuffer_size(width, height);
+                const Graphics::AtlasLayout tiles = Graphics::make_atlas_layout(views.size(), width, height);
+                if (multiview && renderer.draw_atlas(tiles) == false) {
+                    // views too large to fit a framebuffer together
+                    fputs("Drawing the views one at a time instead\n", stderr);
+                    multiview = false;
+                }
+                auto draw_view = [&](size_t v, int& x, int& y) {
+                    if (multiview) {
+                        x = tiles.tile_x(v);
+                        y = tiles.tile_y(v);
+                    } else {
+                        renderer.draw(views[v], width, height);
+                        x = y = 0;
+                    }
+                };
+                if (ring.is_initialized()) {
+                    // each view is mapped and queued once the next one is read, so its copy completes while drawing
+                    size_t previous = 0;
+                    for (size_t v = 0; v <= views.size(); ++v) {
+                        size_t slot = 0;
+                        if (v < views.size()) {
+                            int x{0}, y{0};
+                            draw_view(v, x, y);
+                            slot = ring.read(x, y, width, height, channels);
+                        }
+                        if (v > 0) {
+                            queue_view(v - 1, ring.map(previous), [&ring, previous]() { ring.release(previous); });
+                        }
+                        previous = slot;
+                    }
+                } else {
+                    for (size_t v = 0; v < views.size(); ++v) {
+                        int x{0}, y{0};
+                        draw_view(v, x, y);
+                        queue_view(v, renderer.read_region(x, y, width, height, channels), nullptr);
+                    }
+                }
+            }
+            if (pass_times) {
+                const Graphics::PassTimes times = renderer.pass_times();
+                printf("Passes of \"%s\": prepass %.2f ms, shading %.2f ms\n", files[i].c_str(), times.m_prepass_ms,
+                       times.m_shading_ms);
+            }
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+
+    size_t failures = 0;
+    for (const auto& f : failed) {
+        failures += f ? 1 : 0;
+    }
+    if (count > 1) {
+        printf("Rendered %zu of %zu files\n", count - failures, count);
+    }
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "options.h"
+#include "thread_pool.h"
+
+// Renders the files headless in three overlapping stages connected by bounded queues: loader threads parsing the next
+// files, the calling thread owning the GL context drawing and reading back the views, and encoder threads writing
+// the images. The views of files[i] are written into dirs[i]. Files that fail are reported and skipped.
+int render_pipelined(const std::vector<std::string>& files, const std::vector<std::string>& dirs,
+                     const RenderOptions& opts, ThreadPool& pool);
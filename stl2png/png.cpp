@@ -0,0 +1,295 @@
+#include "png.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "deflate.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace PNG {
+
+namespace {
+const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+// filtered bytes per independently compressed chunk in the parallel mode
+const size_t PARALLEL_CHUNK_BYTES = 512 * 1024;
+
+enum Filter { NONE = 0, SUB = 1, UP = 2, AVERAGE = 3, PAETH = 4, FILTERS = 5 };
+
+struct CRCTables {
+    // slicing by 8, table[k] advances the crc over a byte followed by k zero bytes
+    uint32_t m_table[8][256];
+
+    CRCTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            m_table[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                m_table[k][i] = (m_table[k - 1][i] >> 8) ^ m_table[0][m_table[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+const CRCTables& crc_tables() {
+    static const CRCTables t;
+    return t;
+}
+
+inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+    const uint8_t bytes[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)};
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+// Starts a chunk, the length is filled in and the crc appended by end_chunk
+size_t begin_chunk(std::vector<uint8_t>& out, const char* type) {
+    const size_t start = out.size();
+    put_u32(out, 0);
+    out.insert(out.end(), type, type + 4);
+    return start;
+}
+
+void end_chunk(std::vector<uint8_t>& out, size_t start) {
+    const size_t size = out.size() - start - 8;
+    for (int i = 0; i < 4; ++i) {
+        out[start + i] = uint8_t(size >> (24 - 8 * i));
+    }
+    put_u32(out, crc32(out.data() + start + 4, size + 4));
+}
+
+inline uint8_t paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return uint8_t(a);
+    }
+    return uint8_t(pb <= pc ? b : c);
+}
+
+// Filters a row of bytes, prev is the unfiltered row above, all zeros for the first row
+void filter_row(int filter, const uint8_t* row, const uint8_t* prev, size_t bytes, int bpp, uint8_t* out) {
+    const size_t left = std::min<size_t>(bpp, bytes);
+    switch (filter) {
+        case NONE:
+            memcpy(out, row, bytes);
+            break;
+        case SUB:
+            memcpy(out, row, left);
+            for (size_t i = left; i < bytes; ++i) {
+                out[i] = uint8_t(row[i] - row[i - bpp]);
+            }
+            break;
+        case UP:
+            for (size_t i = 0; i < bytes; ++i) {
+                out[i] = uint8_t(row[i] - prev[i]);
+            }
+            break;
+        case AVERAGE:
+            for (size_t i = 0; i < left; ++i) {
+                out[i] = uint8_t(row[i] - (prev[i] >> 1));
+            }
+            for (size_t i = left; i < bytes; ++i) {
+                out[i] = uint8_t(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+            }
+            break;
+        case PAETH:
+            for (size_t i = 0; i < left; ++i) {
+                out[i] = uint8_t(row[i] - prev[i]);
+            }
+            for (size_t i = left; i < bytes; ++i) {
+                out[i] = uint8_t(row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]));
+            }
+            break;
+    }
+}
+
+inline uint32_t signed_abs(int v) { return uint32_t(std::abs(int(int8_t(uint8_t(v))))); }
+
+// Sums of the filtered bytes taken as signed for all five filters in one pass over the row
+void filter_costs(const uint8_t* row, const uint8_t* prev, size_t bytes, int bpp, uint32_t* cost) {
+    const size_t left = std::min<size_t>(bpp, bytes);
+    uint32_t none = 0, sub = 0, up = 0, average = 0, paeth_cost = 0;
+    for (size_t i = 0; i < left; ++i) {
+        none += signed_abs(row[i]);
+        sub += signed_abs(row[i]);
+        up += signed_abs(row[i] - prev[i]);
+        average += signed_abs(row[i] - (prev[i] >> 1));
+        paeth_cost += signed_abs(row[i] - prev[i]);
+    }
+    size_t i = left;
+#ifdef PNG_SSE2
+    // 16 bytes at a time, the absolute value of a signed byte d is min(d, -d) taken as unsigned
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    auto sum_abs = [&zero](__m128i d) {
+        const __m128i sums = _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero);
+        return uint32_t(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    };
+    auto abs16 = [&zero](__m128i v) { return _mm_max_epi16(v, _mm_sub_epi16(zero, v)); };
+    // paeth predictor on 8 bytes widened to 16 bits, pa = |b - c|, pb = |a - c| and pc = |a + b - 2c|
+    auto paeth8 = [&abs16](__m128i a, __m128i b, __m128i c) {
+        const __m128i pa = abs16(_mm_sub_epi16(b, c));
+        const __m128i pb = abs16(_mm_sub_epi16(a, c));
+        const __m128i pc = abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+        const __m128i use_a = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)),
+                                               _mm_set1_epi16(-1));
+        const __m128i use_b = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+        const __m128i b_or_c = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+        return _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, b_or_c));
+    };
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bpp));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i - bpp));
+        // floor of the average, _mm_avg_epu8 rounds up
+        const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        const __m128i predicted = _mm_packus_epi16(
+            paeth8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+            paeth8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero)));
+        none += sum_abs(x);
+        sub += sum_abs(_mm_sub_epi8(x, a));
+        up += sum_abs(_mm_sub_epi8(x, b));
+        average += sum_abs(_mm_sub_epi8(x, avg));
+        paeth_cost += sum_abs(_mm_sub_epi8(x, predicted));
+    }
+#endif
+    for (; i < bytes; ++i) {
+        const int x = row[i], a = row[i - bpp], b = prev[i], c = prev[i - bpp];
+        const int p = a + b - c;
+        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        const int predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+        none += signed_abs(x);
+        sub += signed_abs(x - a);
+        up += signed_abs(x - b);
+        average += signed_abs(x - ((a + b) >> 1));
+        paeth_cost += signed_abs(x - predicted);
+    }
+    cost[NONE] = none;
+    cost[SUB] = sub;
+    cost[UP] = up;
+    cost[AVERAGE] = average;
+    cost[PAETH] = paeth_cost;
+}
+
+// Filters rows [first, last) into filtered, each prefixed by its filter type. Adaptive filtering uses the filter
+// with the smallest sum of the filtered bytes taken as signed, the usual estimate of what compresses best.
+void filter_rows(const uint8_t* pixels, int stride, size_t row_bytes, int bpp, int first, int last, bool adaptive,
+                 uint8_t* filtered) {
+    const std::vector<uint8_t> zeros(row_bytes, 0);
+    for (int y = first; y < last; ++y) {
+        const uint8_t* row = pixels + size_t(y) * stride;
+        const uint8_t* prev = y > 0 ? row - stride : zeros.data();
+        uint8_t* out = filtered + size_t(y) * (row_bytes + 1);
+        int filter = UP;
+        if (adaptive) {
+            uint32_t cost[FILTERS];
+            filter_costs(row, prev, row_bytes, bpp, cost);
+            filter = int(std::min_element(cost, cost + FILTERS) - cost);
+        }
+        out[0] = uint8_t(filter);
+        filter_row(filter, row, prev, row_bytes, bpp, out + 1);
+    }
+}
+}  // namespace
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    const auto& t = crc_tables().m_table;
+    crc = ~crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        const uint32_t lo = load32(data) ^ crc;
+        const uint32_t hi = load32(data + 4);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; --size) {
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void encode(const uint8_t* pixels, int width, int height, int channels, int stride, const std::vector<uint8_t>& palette,
+            Mode mode, ThreadPool* pool, std::vector<uint8_t>& out) {
+    static const uint8_t COLOR_TYPES[5] = {0, 0, 4, 2, 6};
+    const uint8_t INDEXED = 3;
+    const size_t row_bytes = size_t(width) * channels;
+    const size_t filtered_size = (row_bytes + 1) * height;
+    const bool parallel = mode == Mode::Parallel && pool && pool->size() > 1 && height > 0;
+    const bool adaptive = mode != Mode::Fast;
+    const Deflate::Level level = mode == Mode::Fast ? Deflate::Level::Fast : Deflate::Level::Balanced;
+
+    out.clear();
+    out.reserve(filtered_size / 2 + 1024);
+    out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+    size_t chunk = begin_chunk(out, "IHDR");
+    put_u32(out, uint32_t(width));
+    put_u32(out, uint32_t(height));
+    // 8 bits, deflate, adaptive filtering, no interlace
+    const uint8_t header[5] = {8, palette.empty() ? COLOR_TYPES[channels] : INDEXED, 0, 0, 0};
+    out.insert(out.end(), header, header + 5);
+    end_chunk(out, chunk);
+    if (!palette.empty()) {
+        chunk = begin_chunk(out, "PLTE");
+        out.insert(out.end(), palette.begin(), palette.end());
+        end_chunk(out, chunk);
+    }
+
+    // every byte is written by the filters, left uninitialized
+    std::unique_ptr<uint8_t[]> filtered(new uint8_t[filtered_size]);
+    // chunks of whole rows, one chunk unless compressing in parallel
+    const int chunk_rows =
+        parallel ? int(std::max<size_t>(1, PARALLEL_CHUNK_BYTES / (row_bytes + 1))) : std::max(height, 1);
+    const size_t chunks = (size_t(height) + chunk_rows - 1) / chunk_rows;
+
+    chunk = begin_chunk(out, "IDAT");
+    // zlib header, 32K window and the compression level hint
+    out.push_back(0x78);
+    out.push_back(mode == Mode::Fast ? 0x01 : 0x9c);
+    uint32_t adler = 1;
+    if (parallel) {
+        std::vector<std::vector<uint8_t>> compressed(chunks);
+        std::vector<uint32_t> adlers(chunks);
+        pool->parallel_for(chunks, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                const int y0 = int(c) * chunk_rows;
+                const int y1 = std::min(height, y0 + chunk_rows);
+                uint8_t* data = filtered.get() + size_t(y0) * (row_bytes + 1);
+                const size_t size = size_t(y1 - y0) * (row_bytes + 1);
+                filter_rows(pixels, stride, row_bytes, channels, y0, y1, adaptive, filtered.get());
+                Deflate::compress(data, size, level, c + 1 == chunks, compressed[c]);
+                adlers[c] = Deflate::adler32(data, size);
+            }
+        });
+        for (size_t c = 0; c < chunks; ++c) {
+            out.insert(out.end(), compressed[c].begin(), compressed[c].end());
+            const int rows = std::min(height - int(c) * chunk_rows, chunk_rows);
+            adler = c == 0 ? adlers[c] : Deflate::adler32_combine(adler, adlers[c], size_t(rows) * (row_bytes + 1));
+        }
+    } else {
+        filter_rows(pixels, stride, row_bytes, channels, 0, height, adaptive, filtered.get());
+        Deflate::compress(filtered.get(), filtered_size, level, true, out);
+        adler = Deflate::adler32(filtered.get(), filtered_size);
+    }
+    put_u32(out, adler);
+    end_chunk(out, chunk);
+
+    chunk = begin_chunk(out, "IEND");
+    end_chunk(out, chunk);
+}
+}  // namespace PNG
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Standard PNG files from 8 bit images, a faster alternative to stb_image_write.
+namespace PNG {
+
+enum class Mode {
+    // the Up filter on every row and fast deflate with the fixed Huffman codes
+    Fast,
+    // the filter of each row picked by the smallest sum of absolute differences, deflate with dynamic Huffman codes
+    Balanced,
+    // balanced, with the rows filtered and compressed in independent chunks of the IDAT stream over the pool
+    Parallel,
+};
+
+// Encodes 8 bit pixels with 1 to 4 channels (gray, gray and alpha, RGB, RGBA) as a PNG file in out, rows in memory
+// order. With a palette of up to 256 RGB triples the single channel holds palette indices. The pool is only used in
+// the parallel mode and must not be the pool running the caller.
+void encode(const uint8_t* pixels, int width, int height, int channels, int stride, const std::vector<uint8_t>& palette,
+            Mode mode, ThreadPool* pool, std::vector<uint8_t>& out);
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+}  // namespace PNG
@@ -0,0 +1,103 @@
+#include "qoi.h"
+#include <cstring>
+
+namespace QOI {
+
+namespace {
+const uint8_t OP_INDEX = 0x00;
+const uint8_t OP_DIFF = 0x40;
+const uint8_t OP_LUMA = 0x80;
+const uint8_t OP_RUN = 0xc0;
+const uint8_t OP_RGB = 0xfe;
+const uint8_t OP_RGBA = 0xff;
+const int MAX_RUN = 62;
+const uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+struct Pixel {
+    uint8_t r, g, b, a;
+    bool operator==(const Pixel& p) const { return r == p.r && g == p.g && b == p.b && a == p.a; }
+};
+
+inline unsigned index_of(const Pixel& p) { return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) & 63; }
+
+void put32(uint8_t* out, uint32_t v) {
+    out[0] = uint8_t(v >> 24);
+    out[1] = uint8_t(v >> 16);
+    out[2] = uint8_t(v >> 8);
+    out[3] = uint8_t(v);
+}
+}  // namespace
+
+void encode(const uint8_t* pixels, int width, int height, int channels, int stride, std::vector<uint8_t>& out) {
+    // worst case of one RGBA op per pixel
+    out.resize(14 + size_t(width) * height * (channels + 1) + sizeof(END_MARKER));
+    uint8_t* p = out.data();
+    memcpy(p, "qoif", 4);
+    put32(p + 4, uint32_t(width));
+    put32(p + 8, uint32_t(height));
+    p[12] = uint8_t(channels);
+    // sRGB with linear alpha
+    p[13] = 0;
+    p += 14;
+
+    Pixel index[64];
+    memset(index, 0, sizeof(index));
+    Pixel previous = {0, 0, 0, 255};
+    int run = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = pixels + size_t(y) * stride;
+        for (int x = 0; x < width; ++x, row += channels) {
+            const Pixel pixel = {row[0], row[1], row[2], channels == 4 ? row[3] : uint8_t(255)};
+            if (pixel == previous) {
+                if (++run == MAX_RUN) {
+                    *p++ = uint8_t(OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *p++ = uint8_t(OP_RUN | (run - 1));
+                run = 0;
+            }
+            const unsigned i = index_of(pixel);
+            if (index[i] == pixel) {
+                *p++ = uint8_t(OP_INDEX | i);
+            } else {
+                index[i] = pixel;
+                if (pixel.a == previous.a) {
+                    // channel differences wrap around, as the decoder adds them modulo 256
+                    const int dr = int8_t(pixel.r - previous.r);
+                    const int dg = int8_t(pixel.g - previous.g);
+                    const int db = int8_t(pixel.b - previous.b);
+                    const int dr_dg = dr - dg;
+                    const int db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        *p++ = uint8_t(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        *p++ = uint8_t(OP_LUMA | (dg + 32));
+                        *p++ = uint8_t((dr_dg + 8) << 4 | (db_dg + 8));
+                    } else {
+                        *p++ = OP_RGB;
+                        *p++ = pixel.r;
+                        *p++ = pixel.g;
+                        *p++ = pixel.b;
+                    }
+                } else {
+                    *p++ = OP_RGBA;
+                    *p++ = pixel.r;
+                    *p++ = pixel.g;
+                    *p++ = pixel.b;
+                    *p++ = pixel.a;
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        *p++ = uint8_t(OP_RUN | (run - 1));
+    }
+    memcpy(p, END_MARKER, sizeof(END_MARKER));
+    p += sizeof(END_MARKER);
+    out.resize(p - out.data());
+}
+}  // namespace QOI
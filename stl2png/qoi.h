@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// QOI ("Quite OK Image") files, several times faster to write than PNG at some cost in size.
+namespace QOI {
+
+// Encodes 8 bit RGB or RGBA pixels as a QOI file in out, rows in memory order.
+void encode(const uint8_t* pixels, int width, int height, int channels, int stride, std::vector<uint8_t>& out);
+}  // namespace QOI
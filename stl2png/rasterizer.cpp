@@ -0,0 +1,374 @@
+#include "rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include "shading.h"
+
+namespace Graphics {
+
+namespace {
+const int TILE_SIZE = 64;
+// fixed point bits below the pixel of the vertex positions
+const int SUBPIXEL_BITS = 8;
+const int64_t SUBPIXEL = int64_t(1) << SUBPIXEL_BITS;
+// Clip space positions further out than this many half viewports from the centre are clipped, closer ones are
+// left to the tile bounds. Keeps the fixed point positions within 32 bits.
+const float GUARD_BAND = 8.f;
+const size_t TRANSFORM_CHUNK_VERTICES = 64 * 1024;
+// triangles set up and binned per task, more for large models to bound the number of bins
+const size_t SETUP_CHUNK_TRIANGLES = 16 * 1024;
+const size_t SETUP_CHUNKS_PER_THREAD = 4;
+
+// the near plane and the four sides of the guard band
+const int CLIP_PLANES = 5;
+
+// a polygon vertex while clipping, with its weights of the triangle's vertices
+struct ClipVertex {
+    glm::vec4 m_position;
+    glm::vec3 m_weights;
+};
+
+// distance inside a clip plane, negative outside
+float plane_distance(const glm::vec4& p, int plane) {
+    switch (plane) {
+        case 0:
+            return p.z + p.w;
+        case 1:
+            return GUARD_BAND * p.w - p.x;
+        case 2:
+            return GUARD_BAND * p.w + p.x;
+        case 3:
+            return GUARD_BAND * p.w - p.y;
+        default:
+            return GUARD_BAND * p.w + p.y;
+    }
+}
+
+// Sutherland-Hodgman clipping of a convex polygon against a plane, out holds up to one vertex more than in
+size_t clip_polygon(const ClipVertex* in, size_t count, int plane, ClipVertex* out) {
+    size_t clipped = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        const float da = plane_distance(a.m_position, plane);
+        const float db = plane_distance(b.m_position, plane);
+        if (da >= 0.f) {
+            out[clipped++] = a;
+        }
+        if ((da >= 0.f) != (db >= 0.f)) {
+            const float t = da / (da - db);
+            out[clipped++] = {a.m_position + (b.m_position - a.m_position) * t,
+                              a.m_weights + (b.m_weights - a.m_weights) * t};
+        }
+    }
+    return clipped;
+}
+
+// rounded to the nearest fixed point position, half way away from zero
+int32_t to_fixed(float pixels) {
+    const float v = pixels * float(SUBPIXEL);
+    return int32_t(v >= 0.f ? v + 0.5f : v - 0.5f);
+}
+
+int64_t floor_div(int64_t a, int64_t b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+// the pixels of a tile without a triangle
+const uint32_t NO_CHUNK = 0xffffffffu;
+
+// What the visibility pass leaves per pixel of a tile for the shading, and the fragments to shade, the thread_buffers()
+// of the tiles.
+struct TileBuffers {
+    float m_depth[TILE_SIZE * TILE_SIZE];
+    // the nearest triangle and its barycentrics of vertices 1 and 2
+    uint32_t m_chunk[TILE_SIZE * TILE_SIZE];
+    uint32_t m_triangle[TILE_SIZE * TILE_SIZE];
+    float m_l1[TILE_SIZE * TILE_SIZE];
+    float m_l2[TILE_SIZE * TILE_SIZE];
+    // the pixel of each fragment within the tile
+    uint16_t m_pixel[TILE_SIZE * TILE_SIZE];
+    Shading::Fragments m_fragments;
+};
+static_assert(Shading::Fragments::CAPACITY >= TILE_SIZE * TILE_SIZE, "a tile of fragments");
+}  // namespace
+
+bool Rasterizer::upload(LoadedModel& model, const RenderOptions& opts) {
+    if (take_vertices(model, opts) == false) {
+        return false;
+    }
+    if (m_vertices.size() >= CLIPPED) {
+        fputs("Too many vertices to rasterize\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+Rasterizer::Varyings Rasterizer::varyings(const Chunk& chunk, uint32_t vertex) const {
+    if (vertex & CLIPPED) {
+        return chunk.m_clipped[vertex & ~CLIPPED];
+    }
+    const Vert& v = m_vertices[vertex];
+    return {glm::vec3(v.nx, v.ny, v.nz), glm::vec3(v.x, v.y, v.z)};
+}
+
+void Rasterizer::setup_triangle(Chunk& chunk, const glm::vec4 clip[3], const uint32_t vertices[3], int width,
+                                int height) const {
+    // outside the view volume with all vertices on the same side
+    for (int axis = 0; axis < 3; ++axis) {
+        if ((clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) ||
+            (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)) {
+            return;
+        }
+    }
+    bool inside = true;
+    for (int k = 0; k < 3; ++k) {
+        const float band = GUARD_BAND * clip[k].w;
+        inside = inside && clip[k].z >= -clip[k].w && std::abs(clip[k].x) <= band && std::abs(clip[k].y) <= band;
+    }
+    if (inside) {
+        add_triangle(chunk, clip, vertices, width, height);
+        return;
+    }
+
+    // crossing the near plane or far outside the viewport, clipped to a polygon and drawn as a fan
+    ClipVertex polygon[2][3 + CLIP_PLANES];
+    for (int k = 0; k < 3; ++k) {
+        polygon[0][k] = {clip[k], glm::vec3(k == 0 ? 1.f : 0.f, k == 1 ? 1.f : 0.f, k == 2 ? 1.f : 0.f)};
+    }
+    size_t count = 3;
+    int current = 0;
+    for (int plane = 0; plane < CLIP_PLANES && count >= 3; ++plane) {
+        count = clip_polygon(polygon[current], count, plane, polygon[1 - current]);
+        current = 1 - current;
+    }
+    if (count < 3) {
+        return;
+    }
+    // the varyings of the polygon vertices weighted from the triangle's, linear in clip space
+    const Varyings corners[3] = {varyings(chunk, vertices[0]), varyings(chunk, vertices[1]),
+                                 varyings(chunk, vertices[2])};
+    const uint32_t first = uint32_t(chunk.m_clipped.size());
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3& w = polygon[current][i].m_weights;
+        chunk.m_clipped.push_back(
+            {corners[0].m_normal * w.x + corners[1].m_normal * w.y + corners[2].m_normal * w.z,
+             corners[0].m_position * w.x + corners[1].m_position * w.y + corners[2].m_position * w.z});
+    }
+    for (size_t i = 1; i + 1 < count; ++i) {
+        const glm::vec4 fan[3] = {polygon[current][0].m_position, polygon[current][i].m_position,
+                                  polygon[current][i + 1].m_position};
+        const uint32_t fan_vertices[3] = {CLIPPED | first, CLIPPED | uint32_t(first + i),
+                                          CLIPPED | uint32_t(first + i + 1)};
+        add_triangle(chunk, fan, fan_vertices, width, height);
+    }
+}
+
+void Rasterizer::add_triangle(Chunk& chunk, const glm::vec4 clip[3], const uint32_t vertices[3], int width,
+                              int height) const {
+    Triangle tri;
+    for (int k = 0; k < 3; ++k) {
+        tri.m_inv_w[k] = 1.f / clip[k].w;
+        // the viewport transform, to fixed point pixels of the region
+        tri.m_x[k] = to_fixed((clip[k].x * tri.m_inv_w[k] * 0.5f + 0.5f) * width);
+        tri.m_y[k] = to_fixed((clip[k].y * tri.m_inv_w[k] * 0.5f + 0.5f) * height);
+    }
+    // the pixels with their centre in the bounds, none for most triangles smaller than a pixel
+    const int64_t min_x = std::min({tri.m_x[0], tri.m_x[1], tri.m_x[2]});
+    const int64_t max_x = std::max({tri.m_x[0], tri.m_x[1], tri.m_x[2]});
+    const int64_t min_y = std::min({tri.m_y[0], tri.m_y[1], tri.m_y[2]});
+    const int64_t max_y = std::max({tri.m_y[0], tri.m_y[1], tri.m_y[2]});
+    tri.m_min_x = int32_t(std::max<int64_t>(0, floor_div(min_x - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL)));
+    tri.m_min_y = int32_t(std::max<int64_t>(0, floor_div(min_y - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL)));
+    tri.m_max_x = int32_t(std::min<int64_t>(width - 1, floor_div(max_x - SUBPIXEL / 2, SUBPIXEL)));
+    tri.m_max_y = int32_t(std::min<int64_t>(height - 1, floor_div(max_y - SUBPIXEL / 2, SUBPIXEL)));
+    if (tri.m_min_x > tri.m_max_x || tri.m_min_y > tri.m_max_y) {
+        return;
+    }
+    for (int k = 0; k < 3; ++k) {
+        tri.m_z[k] = clip[k].z * tri.m_inv_w[k] * 0.5f + 0.5f;
+        tri.m_vertex[k] = vertices[k];
+    }
+    const int64_t area = int64_t(tri.m_x[1] - tri.m_x[0]) * (tri.m_y[2] - tri.m_y[0]) -
+                         int64_t(tri.m_x[2] - tri.m_x[0]) * (tri.m_y[1] - tri.m_y[0]);
+    if (area == 0) {
+        return;
+    }
+    // culling is off, clockwise triangles are turned around
+    if (area < 0) {
+        std::swap(tri.m_x[1], tri.m_x[2]);
+        std::swap(tri.m_y[1], tri.m_y[2]);
+        std::swap(tri.m_z[1], tri.m_z[2]);
+        std::swap(tri.m_inv_w[1], tri.m_inv_w[2]);
+        std::swap(tri.m_vertex[1], tri.m_vertex[2]);
+    }
+    chunk.m_triangles.push_back(tri);
+}
+
+void Rasterizer::bin(Chunk& chunk, int columns, int rows) const {
+    // counted per tile, then placed in draw order
+    const size_t tiles = size_t(columns) * rows;
+    chunk.m_tile_start.assign(tiles + 1, 0);
+    for (const Triangle& tri : chunk.m_triangles) {
+        for (int ty = tri.m_min_y / TILE_SIZE; ty <= tri.m_max_y / TILE_SIZE; ++ty) {
+            for (int tx = tri.m_min_x / TILE_SIZE; tx <= tri.m_max_x / TILE_SIZE; ++tx) {
+                ++chunk.m_tile_start[size_t(ty) * columns + tx + 1];
+            }
+        }
+    }
+    for (size_t t = 0; t < tiles; ++t) {
+        chunk.m_tile_start[t + 1] += chunk.m_tile_start[t];
+    }
+    chunk.m_binned.resize(chunk.m_tile_start[tiles]);
+    std::vector<uint32_t> next(chunk.m_tile_start.begin(), chunk.m_tile_start.end() - 1);
+    for (uint32_t i = 0; i < uint32_t(chunk.m_triangles.size()); ++i) {
+        const Triangle& tri = chunk.m_triangles[i];
+        for (int ty = tri.m_min_y / TILE_SIZE; ty <= tri.m_max_y / TILE_SIZE; ++ty) {
+            for (int tx = tri.m_min_x / TILE_SIZE; tx <= tri.m_max_x / TILE_SIZE; ++tx) {
+                chunk.m_binned[next[size_t(ty) * columns + tx]++] = i;
+            }
+        }
+    }
+}
+
+void Rasterizer::raster_tile(const View& view, size_t tile, int columns, Image& image, int x, int y, int width,
+                             int height) const {
+    const Tile region = clear_tile(image, x, y, width, height, tile, columns, TILE_SIZE);
+    const int x0 = region.m_x0, y0 = region.m_y0, x1 = region.m_x1, y1 = region.m_y1;
+    TileBuffers& buffers = thread_buffers<TileBuffers>();
+    std::fill(buffers.m_depth, buffers.m_depth + TILE_SIZE * TILE_SIZE, 1.f);
+    std::fill(buffers.m_chunk, buffers.m_chunk + TILE_SIZE * TILE_SIZE, NO_CHUNK);
+
+    // visibility, the nearest triangle of each pixel
+    for (uint32_t c = 0; c < uint32_t(m_chunks.size()); ++c) {
+        const Chunk& chunk = m_chunks[c];
+        for (uint32_t n = chunk.m_tile_start[tile]; n < chunk.m_tile_start[tile + 1]; ++n) {
+            const Triangle& tri = chunk.m_triangles[chunk.m_binned[n]];
+            const int min_x = std::max(tri.m_min_x, x0), max_x = std::min(tri.m_max_x, x1);
+            const int min_y = std::max(tri.m_min_y, y0), max_y = std::min(tri.m_max_y, y1);
+            // Edge k is opposite vertex k, its function is positive inside and proportional to the barycentric
+            // of vertex k. Evaluated at pixel centres and stepped a pixel at a time.
+            int64_t a[3], b[3], row[3];
+            for (int k = 0; k < 3; ++k) {
+                const int i = (k + 1) % 3, j = (k + 2) % 3;
+                a[k] = int64_t(tri.m_y[i]) - tri.m_y[j];
+                b[k] = int64_t(tri.m_x[j]) - tri.m_x[i];
+                // centres exactly on an edge only belong to the triangle on its top or left side
+                const bool top_left = a[k] > 0 || (a[k] == 0 && b[k] < 0);
+                row[k] = a[k] * (min_x * SUBPIXEL + SUBPIXEL / 2 - tri.m_x[i]) +
+                         b[k] * (min_y * SUBPIXEL + SUBPIXEL / 2 - tri.m_y[i]) - (top_left ? 0 : 1);
+            }
+            const int64_t area = int64_t(tri.m_x[1] - tri.m_x[0]) * (tri.m_y[2] - tri.m_y[0]) -
+                                 int64_t(tri.m_x[2] - tri.m_x[0]) * (tri.m_y[1] - tri.m_y[0]);
+            const float inv_area = float(1.0 / double(area));
+            for (int py = min_y; py <= max_y; ++py) {
+                int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+                for (int px = min_x; px <= max_x; ++px) {
+                    if ((e0 | e1 | e2) >= 0) {
+                        const float l1 = float(e1) * inv_area, l2 = float(e2) * inv_area;
+                        const float z = tri.m_z[0] + l1 * (tri.m_z[1] - tri.m_z[0]) + l2 * (tri.m_z[2] - tri.m_z[0]);
+                        const int p = (py - y0) * TILE_SIZE + (px - x0);
+                        // GL_LESS, behind the far plane fails against the cleared depth
+                        if (z < buffers.m_depth[p] && z >= 0.f) {
+                            buffers.m_depth[p] = z;
+                            buffers.m_chunk[p] = c;
+                            buffers.m_triangle[p] = chunk.m_binned[n];
+                            buffers.m_l1[p] = l1;
+                            buffers.m_l2[p] = l2;
+                        }
+                    }
+                    e0 += a[0] * SUBPIXEL;
+                    e1 += a[1] * SUBPIXEL;
+                    e2 += a[2] * SUBPIXEL;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    row[k] += b[k] * SUBPIXEL;
+                }
+            }
+        }
+    }
+
+    // the varyings of the visible pixels, shaded together once each
+    Shading::Fragments& fragments = buffers.m_fragments;
+    fragments.m_count = 0;
+    const Triangle* last = nullptr;
+    glm::vec3 normal[3], vert2eye[3];
+    for (int py = y0; py <= y1; ++py) {
+        for (int px = x0; px <= x1; ++px) {
+            const int p = (py - y0) * TILE_SIZE + (px - x0);
+            if (buffers.m_chunk[p] == NO_CHUNK) {
+                continue;
+            }
+            const Chunk& chunk = m_chunks[buffers.m_chunk[p]];
+            const Triangle& tri = chunk.m_triangles[buffers.m_triangle[p]];
+            if (&tri != last) {
+                // neighbouring pixels mostly share their triangle
+                last = &tri;
+                for (int k = 0; k < 3; ++k) {
+                    const Varyings v = varyings(chunk, tri.m_vertex[k]);
+                    normal[k] = v.m_normal;
+                    vert2eye[k] = SoftwareRenderer::vert2eye(view, v.m_position);
+                }
+            }
+            // perspective correct weights of the varyings
+            const float l1 = buffers.m_l1[p], l2 = buffers.m_l2[p];
+            const float w0 = (1.f - l1 - l2) * tri.m_inv_w[0], w1 = l1 * tri.m_inv_w[1], w2 = l2 * tri.m_inv_w[2];
+            const float inv = 1.f / (w0 + w1 + w2);
+            const size_t f = fragments.m_count++;
+            for (int c = 0; c < 3; ++c) {
+                fragments.m_normal[c][f] = (normal[0][c] * w0 + normal[1][c] * w1 + normal[2][c] * w2) * inv;
+                fragments.m_vert2eye[c][f] = (vert2eye[0][c] * w0 + vert2eye[1][c] * w1 + vert2eye[2][c] * w2) * inv;
+            }
+            buffers.m_pixel[f] = uint16_t(p);
+        }
+    }
+    shade_tile(fragments, buffers.m_pixel, region);
+}
+
+bool Rasterizer::draw(const View& view, Image& image, int x, int y, int width, int height) {
+    if (width < 1 || height < 1 || width > MAX_SIZE || height > MAX_SIZE) {
+        fprintf(stderr, "Can not rasterize views of %dx%d pixels, at most %d either way\n", width, height, MAX_SIZE);
+        return false;
+    }
+    // the vertices of welded models are transformed once up front, triangle soups as they are set up
+    const glm::mat4 mvp = projection(view, width / (float)height) * view.m_viewMat * view.m_modelMat;
+    auto transform = [&mvp](const Vert& v) { return mvp * glm::vec4(v.x, v.y, v.z, 1.f); };
+    const size_t vertices = m_vertices.size();
+    m_clip.resize(m_indices.empty() ? 0 : vertices);
+    m_pool.parallel_for(m_clip.size(), TRANSFORM_CHUNK_VERTICES, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            m_clip[i] = transform(m_vertices[i]);
+        }
+    });
+
+    const int columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t triangles = (m_indices.empty() ? vertices : m_indices.size()) / 3;
+    const size_t chunks = size_t(m_pool.size()) * SETUP_CHUNKS_PER_THREAD;
+    const size_t chunk_triangles = std::max(SETUP_CHUNK_TRIANGLES, (triangles + chunks - 1) / chunks);
+    m_chunks.resize((triangles + chunk_triangles - 1) / chunk_triangles);
+    m_pool.parallel_for(triangles, chunk_triangles, [&](size_t first, size_t last) {
+        Chunk& chunk = m_chunks[first / chunk_triangles];
+        chunk.m_triangles.clear();
+        chunk.m_clipped.clear();
+        for (size_t t = first; t < last; ++t) {
+            uint32_t corners[3];
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; ++k) {
+                if (m_indices.empty()) {
+                    corners[k] = uint32_t(3 * t + k);
+                    clip[k] = transform(m_vertices[corners[k]]);
+                } else {
+                    corners[k] = m_indices[3 * t + k];
+                    clip[k] = m_clip[corners[k]];
+                }
+            }
+            setup_triangle(chunk, clip, corners, width, height);
+        }
+        bin(chunk, columns, rows);
+    });
+
+    m_pool.parallel_steal(size_t(columns) * rows,
+                          [&](size_t tile) { raster_tile(view, tile, columns, image, x, y, width, height); });
+    return true;
+}
+}  // namespace Graphics
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+#include "software_renderer.h"
+
+namespace Graphics {
+
+// The software renderer of -renderer raster. The triangles are set up and binned into 64x64 pixel tiles in chunks
+// over the pool, then the pool's threads rasterize the tiles with half-space edge functions, each tile with a depth
+// buffer of its own, stealing tiles from each other once done with their share. A tile keeps the nearest triangle of
+// each pixel and shades the visible pixels together once it is done, with the vector shading of shading.h.
+class Rasterizer : public SoftwareRenderer {
+   public:
+    // fixed point positions keep to 32 bits up to this size either way
+    static const int MAX_SIZE = 16384;
+
+    explicit Rasterizer(ThreadPool& pool) : SoftwareRenderer(pool) {}
+
+    bool upload(LoadedModel& model, const RenderOptions& opts) override;
+    bool draw(const View& view, Image& image, int x, int y, int width, int height) override;
+
+   private:
+    // what vertex.glsl interpolates for fragment.glsl, the vector to the eye is affine in the position and so
+    // made from the interpolated position
+    struct Varyings {
+        glm::vec3 m_normal;
+        glm::vec3 m_position;
+    };
+
+    // a counter clockwise triangle in fixed point pixels of the region drawn
+    struct Triangle {
+        int32_t m_x[3], m_y[3];
+        // pixels with their centre within the bounds of the triangle and the region
+        int32_t m_min_x, m_min_y, m_max_x, m_max_y;
+        // window depth and 1/w for perspective correct varyings
+        float m_z[3];
+        float m_inv_w[3];
+        // vertex of the varyings, or with CLIPPED set one made by clipping, kept with the chunk
+        uint32_t m_vertex[3];
+    };
+
+    // triangles set up from a run of the model's triangles, in draw order and binned per tile
+    struct Chunk {
+        std::vector<Triangle> m_triangles;
+        std::vector<Varyings> m_clipped;
+        // the triangles overlapping tile t are m_binned[m_tile_start[t]] up to m_binned[m_tile_start[t + 1]]
+        std::vector<uint32_t> m_tile_start;
+        std::vector<uint32_t> m_binned;
+    };
+
+    static const uint32_t CLIPPED = 0x80000000u;
+
+    Varyings varyings(const Chunk& chunk, uint32_t vertex) const;
+    void setup_triangle(Chunk& chunk, const glm::vec4 clip[3], const uint32_t vertices[3], int width,
+                        int height) const;
+    void add_triangle(Chunk& chunk, const glm::vec4 clip[3], const uint32_t vertices[3], int width,
+                      int height) const;
+    void bin(Chunk& chunk, int columns, int rows) const;
+    void raster_tile(const View& view, size_t tile, int columns, Image& image, int x, int y, int width,
+                     int height) const;
+
+    // per draw, kept to reuse their memory. Only shared vertices of welded models are transformed up front.
+    std::vector<glm::vec4> m_clip;
+    std::vector<Chunk> m_chunks;
+};
+}  // namespace Graphics
@@ -0,0 +1,565 @@
+#include "raycaster.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include "shading.h"
+#include "simd.h"
+
+namespace Graphics {
+
+namespace {
+const int TILE_SIZE = 32;
+// centroid bins per axis for the surface area heuristic
+const int BINS = 16;
+const size_t MAX_LEAF_TRIANGLES = 8;
+// the cost of visiting a node against that of testing a triangle
+const float TRAVERSAL_COST = 2.f;
+// Below this depth the heuristic picks the splits, deeper ones halve the triangles until they fit a leaf, so no
+// branch of the hierarchy is more than 32 deeper.
+const int SAH_DEPTH = 64;
+const size_t STACK_SIZE = SAH_DEPTH + 32 + 1;
+// nodes with more triangles are binned in chunks over the pool, the subtrees of smaller ones built by a thread each
+const size_t SUBTREE_TRIANGLES = 64 * 1024;
+const size_t BIN_CHUNK_TRIANGLES = 64 * 1024;
+const size_t TRIANGLE_CHUNK = 64 * 1024;
+// a ray without a triangle
+const uint32_t NO_TRIANGLE = 0xffffffffu;
+
+struct Box {
+    glm::vec3 m_min{FLT_MAX}, m_max{-FLT_MAX};
+
+    // a component at a time, consecutive triangles mostly grow the same bins
+    void grow(const glm::vec3& p) {
+        for (int a = 0; a < 3; ++a) {
+            m_min[a] = std::min(m_min[a], p[a]);
+            m_max[a] = std::max(m_max[a], p[a]);
+        }
+    }
+    void grow(const Box& box) {
+        for (int a = 0; a < 3; ++a) {
+            m_min[a] = std::min(m_min[a], box.m_min[a]);
+            m_max[a] = std::max(m_max[a], box.m_max[a]);
+        }
+    }
+    glm::vec3 center() const { return (m_min + m_max) * 0.5f; }
+    // half the surface area, 0 when empty
+    float area() const {
+        const glm::vec3 d = m_max - m_min;
+        return d.x < 0.f ? 0.f : d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+// the triangles of a node counted into bins of their centroids along each axis, fewer bins for small nodes
+struct Bins {
+    int m_bins;
+    Box m_bounds[3][BINS];
+    uint32_t m_count[3][BINS];
+
+    explicit Bins(int bins) : m_bins(bins) {
+        for (int a = 0; a < 3; ++a) {
+            std::fill(m_count[a], m_count[a] + bins, 0u);
+        }
+    }
+    void add(const Bins& bins) {
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < m_bins; ++b) {
+                m_bounds[a][b].grow(bins.m_bounds[a][b]);
+                m_count[a][b] += bins.m_count[a][b];
+            }
+        }
+    }
+};
+
+// a triangle while building, its bounds moved along with it so each node's are next to each other
+struct Primitive {
+    Box m_bounds;
+    uint32_t m_triangle;
+};
+
+// the primitives m_first up to m_first + m_count, under a node still to be split
+struct Range {
+    uint32_t m_node;
+    uint32_t m_first, m_count;
+    int m_depth;
+    Box m_centroids;
+};
+
+// the bin of a centroid along each axis, over the centroid bounds of a range
+struct Binning {
+    int m_bins;
+    glm::vec3 m_min, m_scale;
+
+    explicit Binning(const Range& range)
+        : m_bins(int(std::min<uint32_t>(range.m_count, BINS))), m_min(range.m_centroids.m_min) {
+        for (int a = 0; a < 3; ++a) {
+            const float extent = range.m_centroids.m_max[a] - range.m_centroids.m_min[a];
+            m_scale[a] = extent > 0.f ? m_bins / extent : 0.f;
+        }
+    }
+    int bin(const glm::vec3& centroid, int axis) const {
+        const int b = int((centroid[axis] - m_min[axis]) * m_scale[axis]);
+        return std::min(std::max(b, 0), m_bins - 1);
+    }
+};
+
+void bin(const Primitive* primitives, size_t first, size_t last, const Binning& binning, Bins& bins) {
+    for (size_t i = first; i < last; ++i) {
+        const Box& box = primitives[i].m_bounds;
+        const glm::vec3 centroid = box.center();
+        for (int a = 0; a < 3; ++a) {
+            const int b = binning.bin(centroid, a);
+            bins.m_bounds[a][b].grow(box);
+            ++bins.m_count[a][b];
+        }
+    }
+}
+
+// the bounds of the primitives and of their centroids
+void bound(const Primitive* first, const Primitive* last, Box& box, Box& centroids) {
+    for (const Primitive* p = first; p < last; ++p) {
+        box.grow(p->m_bounds);
+        centroids.grow(p->m_bounds.center());
+    }
+}
+
+// where a node is split, bins of the heuristic or halves of the triangles
+struct Split {
+    int m_axis;
+    // the first bin of the second child, -1 to halve
+    int m_bin;
+    Box m_bounds[2], m_centroids[2];
+    uint32_t m_first_count;
+};
+
+// The cheapest split of the range by the surface area heuristic of its bins, false when a leaf is cheaper. Too deep
+// or with all centroids in one place the triangles are halved along the longest axis of the centroids.
+bool find_split(const Bins& bins, const Range& range, const RayCaster::Node& node, Split& split) {
+    Box box;
+    box.m_min = glm::vec3(node.m_min[0], node.m_min[1], node.m_min[2]);
+    box.m_max = glm::vec3(node.m_max[0], node.m_max[1], node.m_max[2]);
+    const float leaf_cost = box.area() * float(range.m_count);
+
+    // the planes between two bins, sweeping the bins from the right and then from the left
+    split.m_bin = -1;
+    float best_cost = FLT_MAX;
+    if (range.m_depth < SAH_DEPTH) {
+        for (int a = 0; a < 3; ++a) {
+            float right_area[BINS];
+            uint32_t right_count[BINS];
+            Box right;
+            uint32_t count = 0;
+            for (int b = bins.m_bins - 1; b > 0; --b) {
+                right.grow(bins.m_bounds[a][b]);
+                count += bins.m_count[a][b];
+                right_area[b] = right.area();
+                right_count[b] = count;
+            }
+            Box left;
+            count = 0;
+            for (int b = 1; b < bins.m_bins; ++b) {
+                left.grow(bins.m_bounds[a][b - 1]);
+                count += bins.m_count[a][b - 1];
+                if (count == 0 || right_count[b] == 0) {
+                    continue;
+                }
+                const float cost = left.area() * float(count) + right_area[b] * float(right_count[b]);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    split.m_axis = a;
+                    split.m_bin = b;
+                }
+            }
+        }
+    }
+    if (range.m_count <= MAX_LEAF_TRIANGLES &&
+        (split.m_bin < 0 || leaf_cost <= TRAVERSAL_COST * box.area() + best_cost)) {
+        return false;
+    }
+    if (split.m_bin < 0) {
+        const glm::vec3 extent = range.m_centroids.m_max - range.m_centroids.m_min;
+        split.m_axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        return true;
+    }
+    for (int b = 0; b < bins.m_bins; ++b) {
+        split.m_bounds[b < split.m_bin ? 0 : 1].grow(bins.m_bounds[split.m_axis][b]);
+    }
+    return true;
+}
+
+// moves the primitives of the first child of the split ahead of the others, with the centroid bounds of both
+void partition(Primitive* primitives, const Range& range, const Binning& binning, Split& split) {
+    Primitive* first = primitives + range.m_first;
+    Primitive* last = first + range.m_count;
+    Primitive* middle = first + range.m_count / 2;
+    if (split.m_bin < 0) {
+        std::nth_element(first, middle, last, [&split](const Primitive& a, const Primitive& b) {
+            return a.m_bounds.center()[split.m_axis] < b.m_bounds.center()[split.m_axis];
+        });
+        bound(first, middle, split.m_bounds[0], split.m_centroids[0]);
+        bound(middle, last, split.m_bounds[1], split.m_centroids[1]);
+    } else {
+        middle = first;
+        for (Primitive* p = first; p < last; ++p) {
+            const glm::vec3 centroid = p->m_bounds.center();
+            const bool left = binning.bin(centroid, split.m_axis) < split.m_bin;
+            split.m_centroids[left ? 0 : 1].grow(centroid);
+            if (left) {
+                std::swap(*p, *middle++);
+            }
+        }
+    }
+    split.m_first_count = uint32_t(middle - first);
+}
+
+// makes the node of the range an inner node with the two children of the split, added after the nodes
+void add_children(const Range& range, const Split& split, std::vector<RayCaster::Node>& nodes, Range children[2]) {
+    const uint32_t child = uint32_t(nodes.size());
+    RayCaster::Node& node = nodes[range.m_node];
+    node.m_first = child;
+    node.m_count = 0;
+    node.m_axis = uint16_t(split.m_axis);
+    nodes.resize(nodes.size() + 2);
+    for (int c = 0; c < 2; ++c) {
+        RayCaster::Node& n = nodes[child + c];
+        for (int a = 0; a < 3; ++a) {
+            n.m_min[a] = split.m_bounds[c].m_min[a];
+            n.m_max[a] = split.m_bounds[c].m_max[a];
+        }
+        children[c].m_node = child + c;
+        children[c].m_first = c == 0 ? range.m_first : range.m_first + split.m_first_count;
+        children[c].m_count = c == 0 ? split.m_first_count : range.m_count - split.m_first_count;
+        children[c].m_depth = range.m_depth + 1;
+        children[c].m_centroids = split.m_centroids[c];
+    }
+}
+
+// partition() of a large range over the pool, the primitives of each side counted per chunk and then moved to their
+// side through the scratch space
+void partition(ThreadPool& pool, const Range& range, const Binning& binning, Split& split,
+               std::vector<Primitive>& primitives, std::vector<Primitive>& scratch) {
+    scratch.resize(primitives.size());
+    const size_t chunks = (range.m_count + BIN_CHUNK_TRIANGLES - 1) / BIN_CHUNK_TRIANGLES;
+    std::vector<uint32_t> first_counts(chunks);
+    std::vector<Box> centroids(2 * chunks);
+    Primitive* const first = primitives.data() + range.m_first;
+    auto in_first = [&binning, &split](const Primitive& p) {
+        return binning.bin(p.m_bounds.center(), split.m_axis) < split.m_bin;
+    };
+    pool.parallel_for(range.m_count, BIN_CHUNK_TRIANGLES, [&](size_t begin, size_t end) {
+        const size_t c = begin / BIN_CHUNK_TRIANGLES;
+        uint32_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const bool left = in_first(first[i]);
+            centroids[2 * c + (left ? 0 : 1)].grow(first[i].m_bounds.center());
+            count += left ? 1 : 0;
+        }
+        first_counts[c] = count;
+    });
+    std::vector<uint32_t> first_starts(chunks), second_starts(chunks);
+    uint32_t firsts = 0, seconds = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        first_starts[c] = firsts;
+        second_starts[c] = seconds;
+        firsts += first_counts[c];
+        seconds += uint32_t(std::min<size_t>(BIN_CHUNK_TRIANGLES, range.m_count - c * BIN_CHUNK_TRIANGLES)) -
+                   first_counts[c];
+        split.m_centroids[0].grow(centroids[2 * c]);
+        split.m_centroids[1].grow(centroids[2 * c + 1]);
+    }
+    Primitive* const moved = scratch.data() + range.m_first;
+    pool.parallel_for(range.m_count, BIN_CHUNK_TRIANGLES, [&](size_t begin, size_t end) {
+        const size_t c = begin / BIN_CHUNK_TRIANGLES;
+        Primitive* to_first = moved + first_starts[c];
+        Primitive* to_second = moved + firsts + second_starts[c];
+        for (size_t i = begin; i < end; ++i) {
+            *(in_first(first[i]) ? to_first++ : to_second++) = first[i];
+        }
+    });
+    pool.parallel_for(range.m_count, BIN_CHUNK_TRIANGLES,
+                      [&](size_t begin, size_t end) { std::copy(moved + begin, moved + end, first + begin); });
+    split.m_first_count = firsts;
+}
+
+// builds the subtree of the range on one thread, its root the first of the nodes
+void build_subtree(Primitive* primitives, const Range& root, std::vector<RayCaster::Node>& nodes) {
+    std::vector<Range> ranges = {root};
+    while (!ranges.empty()) {
+        const Range range = ranges.back();
+        ranges.pop_back();
+        const Binning binning(range);
+        Bins bins(binning.m_bins);
+        bin(primitives, range.m_first, range.m_first + range.m_count, binning, bins);
+        Split split;
+        if (find_split(bins, range, nodes[range.m_node], split) == false) {
+            RayCaster::Node& leaf = nodes[range.m_node];
+            leaf.m_first = range.m_first;
+            leaf.m_count = uint16_t(range.m_count);
+            leaf.m_axis = 0;
+            continue;
+        }
+        partition(primitives, range, binning, split);
+        Range children[2];
+        add_children(range, split, nodes, children);
+        ranges.push_back(children[1]);
+        ranges.push_back(children[0]);
+    }
+}
+
+// The rays of a packet, lanes past the tile with nothing to hit. The nearest hits are returned in place.
+struct Packet {
+    static const size_t MAX_LANES = 16;
+    alignas(64) float m_origin[3][MAX_LANES];
+    alignas(64) float m_direction[3][MAX_LANES];
+    alignas(64) float m_inverse[3][MAX_LANES];
+    // the far end of the rays at 1, -1 for lanes without a ray, then the nearest hit
+    alignas(64) float m_t[MAX_LANES];
+    // the barycentrics of vertices 1 and 2 of the triangle hit
+    alignas(64) float m_u[MAX_LANES];
+    alignas(64) float m_v[MAX_LANES];
+    uint32_t m_triangle[MAX_LANES];
+    // whether the first ray goes down each axis
+    bool m_negative[3];
+};
+
+#define SIMD_KERNEL "raycaster_lanes.h"
+#include "simd_lanes.h"
+#undef SIMD_KERNEL
+
+// the packet traversal of the widest instruction set and the pixels of its packets
+struct Tracer {
+    void (*m_trace)(const RayCaster::Node*, const RayCaster::Triangle*, Packet&);
+    int m_columns, m_rows;
+};
+
+Tracer tracer() {
+    switch (SIMD::instructions()) {
+#ifdef SIMD_X86
+        case SIMD::Instructions::AVX512:
+            return {avx512::trace, 4, 4};
+        case SIMD::Instructions::AVX2:
+            return {avx2::trace, 4, 2};
+        case SIMD::Instructions::SSE2:
+            return {sse2::trace, 2, 2};
+#endif
+        default:
+            return {scalar::trace, 1, 1};
+    }
+}
+
+// the packet and the fragments of a tile, the thread_buffers() of the tiles
+struct TileBuffers {
+    Packet m_packet;
+    // the pixel of each fragment within the tile
+    uint16_t m_pixel[TILE_SIZE * TILE_SIZE];
+    Shading::Fragments m_fragments;
+};
+static_assert(Shading::Fragments::CAPACITY >= TILE_SIZE * TILE_SIZE, "a tile of fragments");
+}  // namespace
+
+bool RayCaster::upload(LoadedModel& model, const RenderOptions& opts) {
+    if (take_vertices(model, opts) == false) {
+        return false;
+    }
+    if ((m_indices.empty() ? m_vertices.size() : m_indices.size()) / 3 >= NO_TRIANGLE) {
+        fputs("Too many triangles to cast rays at\n", stderr);
+        return false;
+    }
+    build();
+    return true;
+}
+
+void RayCaster::build() {
+    const size_t triangles = (m_indices.empty() ? m_vertices.size() : m_indices.size()) / 3;
+    auto corner = [this](size_t t, int k) {
+        const Vert& v = m_vertices[m_indices.empty() ? 3 * t + k : m_indices[3 * t + k]];
+        return glm::vec3(v.x, v.y, v.z);
+    };
+    m_nodes.clear();
+    m_triangles.clear();
+    if (triangles == 0) {
+        return;
+    }
+
+    // the bounds of each triangle, and of all and their centroids a chunk at a time
+    std::vector<Primitive> primitives(triangles);
+    const size_t chunks = (triangles + TRIANGLE_CHUNK - 1) / TRIANGLE_CHUNK;
+    std::vector<Box> chunk_bounds(chunks), chunk_centroids(chunks);
+    m_pool.parallel_for(triangles, TRIANGLE_CHUNK, [&](size_t first, size_t last) {
+        Box& all = chunk_bounds[first / TRIANGLE_CHUNK];
+        Box& centroids = chunk_centroids[first / TRIANGLE_CHUNK];
+        for (size_t t = first; t < last; ++t) {
+            Box& bounds = primitives[t].m_bounds;
+            bounds = Box();
+            for (int k = 0; k < 3; ++k) {
+                bounds.grow(corner(t, k));
+            }
+            primitives[t].m_triangle = uint32_t(t);
+            all.grow(bounds);
+            centroids.grow(bounds.center());
+        }
+    });
+    Range root{0, 0, uint32_t(triangles), 0, Box()};
+    Box all;
+    for (size_t c = 0; c < chunks; ++c) {
+        all.grow(chunk_bounds[c]);
+        root.m_centroids.grow(chunk_centroids[c]);
+    }
+    m_nodes.resize(1);
+    for (int a = 0; a < 3; ++a) {
+        m_nodes[0].m_min[a] = all.m_min[a];
+        m_nodes[0].m_max[a] = all.m_max[a];
+    }
+    // the large nodes near the root split one at a time, each binned and partitioned over the pool
+    std::vector<Primitive> scratch;
+    std::vector<Range> ranges = {root}, subtrees;
+    while (!ranges.empty()) {
+        const Range range = ranges.back();
+        ranges.pop_back();
+        if (range.m_count <= SUBTREE_TRIANGLES) {
+            subtrees.push_back(range);
+            continue;
+        }
+        const Binning binning(range);
+        std::vector<Bins> chunk_bins((range.m_count + BIN_CHUNK_TRIANGLES - 1) / BIN_CHUNK_TRIANGLES, Bins(BINS));
+        m_pool.parallel_for(range.m_count, BIN_CHUNK_TRIANGLES, [&](size_t first, size_t last) {
+            bin(primitives.data() + range.m_first, first, last, binning, chunk_bins[first / BIN_CHUNK_TRIANGLES]);
+        });
+        for (size_t c = 1; c < chunk_bins.size(); ++c) {
+            chunk_bins[0].add(chunk_bins[c]);
+        }
+        // more triangles than a leaf takes, always split
+        Split split;
+        find_split(chunk_bins[0], range, m_nodes[range.m_node], split);
+        if (split.m_bin < 0) {
+            partition(primitives.data(), range, binning, split);
+        } else {
+            partition(m_pool, range, binning, split, primitives, scratch);
+        }
+        Range children[2];
+        add_children(range, split, m_nodes, children);
+        ranges.push_back(children[1]);
+        ranges.push_back(children[0]);
+    }
+
+    // then the subtrees below them by a thread each, appended with their child indices moved along
+    std::vector<std::vector<Node>> built(subtrees.size());
+    m_pool.parallel_steal(subtrees.size(), [&](size_t s) {
+        Range range = subtrees[s];
+        built[s].push_back(m_nodes[range.m_node]);
+        range.m_node = 0;
+        build_subtree(primitives.data(), range, built[s]);
+    });
+    for (size_t s = 0; s < subtrees.size(); ++s) {
+        const uint32_t offset = uint32_t(m_nodes.size()) - 1;
+        for (size_t n = 0; n < built[s].size(); ++n) {
+            Node node = built[s][n];
+            if (node.m_count == 0) {
+                node.m_first += offset;
+            }
+            if (n == 0) {
+                m_nodes[subtrees[s].m_node] = node;
+            } else {
+                m_nodes.push_back(node);
+            }
+        }
+        std::vector<Node>().swap(built[s]);
+    }
+
+    // the triangles in the order of the leaves, as the intersection test takes them
+    m_triangles.resize(triangles);
+    m_pool.parallel_for(triangles, TRIANGLE_CHUNK, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const uint32_t t = primitives[i].m_triangle;
+            const glm::vec3 v0 = corner(t, 0);
+            m_triangles[i] = {v0, corner(t, 1) - v0, corner(t, 2) - v0, t};
+        }
+    });
+}
+
+void RayCaster::cast_tile(const View& view, const glm::mat4& unproject, size_t tile, int columns, Image& image, int x,
+                          int y, int width, int height) const {
+    const Tile region = clear_tile(image, x, y, width, height, tile, columns, TILE_SIZE);
+    const int x0 = region.m_x0, y0 = region.m_y0, x1 = region.m_x1, y1 = region.m_y1;
+    if (m_triangles.empty()) {
+        return;
+    }
+
+    static const Tracer TRACER = tracer();
+    TileBuffers& buffers = thread_buffers<TileBuffers>();
+    Packet& packet = buffers.m_packet;
+    Shading::Fragments& fragments = buffers.m_fragments;
+    fragments.m_count = 0;
+    const int lanes = TRACER.m_columns * TRACER.m_rows;
+    for (int by = y0; by <= y1; by += TRACER.m_rows) {
+        for (int bx = x0; bx <= x1; bx += TRACER.m_columns) {
+            // from the near plane to the far plane through the pixel centres, in model space
+            for (int l = 0; l < lanes; ++l) {
+                const int px = bx + l % TRACER.m_columns, py = by + l / TRACER.m_columns;
+                const bool inside = px <= x1 && py <= y1;
+                const float ndc_x = ((inside ? px : bx) + 0.5f) * 2.f / width - 1.f;
+                const float ndc_y = ((inside ? py : by) + 0.5f) * 2.f / height - 1.f;
+                const glm::vec4 near_point = unproject * glm::vec4(ndc_x, ndc_y, -1.f, 1.f);
+                const glm::vec4 far_point = unproject * glm::vec4(ndc_x, ndc_y, 1.f, 1.f);
+                const glm::vec3 start = glm::vec3(near_point) / near_point.w;
+                const glm::vec3 direction = glm::vec3(far_point) / far_point.w - start;
+                for (int a = 0; a < 3; ++a) {
+                    // tiny instead of 0 keeps the slab tests finite
+                    const float d = std::abs(direction[a]) < 1e-20f ? (direction[a] < 0.f ? -1e-20f : 1e-20f)
+                                                                    : direction[a];
+                    packet.m_origin[a][l] = start[a];
+                    packet.m_direction[a][l] = d;
+                    packet.m_inverse[a][l] = 1.f / d;
+                }
+                packet.m_t[l] = inside ? 1.f : -1.f;
+            }
+            for (int a = 0; a < 3; ++a) {
+                packet.m_negative[a] = packet.m_direction[a][0] < 0.f;
+            }
+            TRACER.m_trace(m_nodes.data(), m_triangles.data(), packet);
+
+            // the varyings of vertex.glsl at the hits
+            for (int l = 0; l < lanes; ++l) {
+                const uint32_t t = packet.m_triangle[l];
+                if (t == NO_TRIANGLE) {
+                    continue;
+                }
+                const float u = packet.m_u[l], v = packet.m_v[l];
+                const float weights[3] = {1.f - u - v, u, v};
+                glm::vec3 normal(0.f), position(0.f);
+                for (int k = 0; k < 3; ++k) {
+                    const Vert& vert = m_vertices[m_indices.empty() ? 3 * size_t(t) + k : m_indices[3 * size_t(t) + k]];
+                    normal += weights[k] * glm::vec3(vert.nx, vert.ny, vert.nz);
+                    position += weights[k] * glm::vec3(vert.x, vert.y, vert.z);
+                }
+                const glm::vec3 eye = vert2eye(view, position);
+                const size_t f = fragments.m_count++;
+                for (int c = 0; c < 3; ++c) {
+                    fragments.m_normal[c][f] = normal[c];
+                    fragments.m_vert2eye[c][f] = eye[c];
+                }
+                const int px = bx + l % TRACER.m_columns, py = by + l / TRACER.m_columns;
+                buffers.m_pixel[f] = uint16_t((py - y0) * TILE_SIZE + (px - x0));
+            }
+        }
+    }
+    shade_tile(fragments, buffers.m_pixel, region);
+}
+
+bool RayCaster::draw(const View& view, Image& image, int x, int y, int width, int height) {
+    if (width < 1 || height < 1) {
+        fprintf(stderr, "Can not cast views of %dx%d pixels\n", width, height);
+        return false;
+    }
+    // the inverse in double, the near plane is close
+    const glm::dmat4 mvp(projection(view, width / (float)height) * view.m_viewMat * view.m_modelMat);
+    const glm::mat4 unproject(glm::inverse(mvp));
+    const int columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_pool.parallel_steal(size_t(columns) * rows, [&](size_t tile) {
+        cast_tile(view, unproject, tile, columns, image, x, y, width, height);
+    });
+    return true;
+}
+}  // namespace Graphics
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+#include "software_renderer.h"
+
+namespace Graphics {
+
+// The software renderer of -renderer raycast, primary rays through a bounding volume hierarchy instead of drawing
+// every triangle, so a view takes time with its pixels and the log of the triangles. The hierarchy is built once per
+// model with the surface area heuristic over binned centroids, the large nodes near the root binned and partitioned
+// in chunks over the pool and the subtrees below them built by the pool's threads. Views are cast in 32x32 pixel
+// tiles stolen by the pool's threads, in packets of a ray per lane of the widest vectors of simd.h that go down the
+// hierarchy together. The nearest triangles of a tile are shaded together like the rasterizer's.
+class RayCaster : public SoftwareRenderer {
+   public:
+    // a node of the hierarchy, its children next to each other so one index finds both
+    struct Node {
+        float m_min[3];
+        // the first child of inner nodes, the first triangle of leaves
+        uint32_t m_first;
+        float m_max[3];
+        // triangles of a leaf, 0 for inner nodes
+        uint16_t m_count;
+        // the axis inner nodes are split on, their first child holds the lower centroids
+        uint16_t m_axis;
+    };
+
+    // a triangle as the intersection test takes it, in the order of the leaves
+    struct Triangle {
+        glm::vec3 m_v0, m_e1, m_e2;
+        // the model's triangle, for its vertices
+        uint32_t m_id;
+    };
+
+    explicit RayCaster(ThreadPool& pool) : SoftwareRenderer(pool) {}
+
+    bool upload(LoadedModel& model, const RenderOptions& opts) override;
+    bool draw(const View& view, Image& image, int x, int y, int width, int height) override;
+
+   private:
+    void build();
+    void cast_tile(const View& view, const glm::mat4& unproject, size_t tile, int columns, Image& image, int x, int y,
+                   int width, int height) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+};
+}  // namespace Graphics
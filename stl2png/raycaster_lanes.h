@@ -0,0 +1,74 @@
+// The packet traversal of raycaster.cpp, its SIMD_KERNEL compiled for each instruction set by simd_lanes.h.
+
+// Sends the rays of the packet down the hierarchy together, a ray per lane, and keeps the nearest triangle of each
+// with its barycentrics of vertices 1 and 2. Nodes are skipped once no ray of the packet can hit them any nearer.
+void trace(const RayCaster::Node* nodes, const RayCaster::Triangle* triangles, Packet& packet) {
+    const Lanes zero = Lanes::set(0.f), one = Lanes::set(1.f);
+    Lanes o[3], d[3], inverse[3];
+    for (int a = 0; a < 3; ++a) {
+        o[a] = Lanes::load(packet.m_origin[a]);
+        d[a] = Lanes::load(packet.m_direction[a]);
+        inverse[a] = Lanes::load(packet.m_inverse[a]);
+    }
+    Lanes t = Lanes::load(packet.m_t), u = zero, v = zero;
+    uint32_t hit[Lanes::WIDTH];
+    std::fill(hit, hit + Lanes::WIDTH, NO_TRIANGLE);
+
+    uint32_t stack[STACK_SIZE];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const RayCaster::Node& node = nodes[stack[--top]];
+        // the slabs of the box, NaN free as the directions are never 0
+        Lanes enter = zero, leave = t;
+        for (int a = 0; a < 3; ++a) {
+            const Lanes lo = (Lanes::set(node.m_min[a]) - o[a]) * inverse[a];
+            const Lanes hi = (Lanes::set(node.m_max[a]) - o[a]) * inverse[a];
+            enter = max(enter, min(lo, hi));
+            leave = min(leave, max(lo, hi));
+        }
+        if (!any(enter <= leave)) {
+            continue;
+        }
+        if (node.m_count == 0) {
+            // the child nearer along the packet's direction on top
+            const bool back = packet.m_negative[node.m_axis];
+            stack[top++] = back ? node.m_first : node.m_first + 1;
+            stack[top++] = back ? node.m_first + 1 : node.m_first;
+            continue;
+        }
+        for (uint32_t i = node.m_first; i < node.m_first + node.m_count; ++i) {
+            // Moller-Trumbore without culling, both sides are drawn
+            const RayCaster::Triangle& tri = triangles[i];
+            const Lanes e1x = Lanes::set(tri.m_e1.x), e1y = Lanes::set(tri.m_e1.y), e1z = Lanes::set(tri.m_e1.z);
+            const Lanes e2x = Lanes::set(tri.m_e2.x), e2y = Lanes::set(tri.m_e2.y), e2z = Lanes::set(tri.m_e2.z);
+            const Lanes px = d[1] * e2z - d[2] * e2y, py = d[2] * e2x - d[0] * e2z, pz = d[0] * e2y - d[1] * e2x;
+            const Lanes det = e1x * px + e1y * py + e1z * pz;
+            const Lanes inv_det = one / det;
+            const Lanes sx = o[0] - Lanes::set(tri.m_v0.x), sy = o[1] - Lanes::set(tri.m_v0.y),
+                        sz = o[2] - Lanes::set(tri.m_v0.z);
+            const Lanes hu = (sx * px + sy * py + sz * pz) * inv_det;
+            const Lanes qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+            const Lanes hv = (d[0] * qx + d[1] * qy + d[2] * qz) * inv_det;
+            const Lanes ht = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+            // false for parallel rays, their NaN and infinities fail the comparisons
+            const Mask nearer = (hu >= zero) & (hv >= zero) & (hu + hv <= one) & (ht >= zero) & (ht < t);
+            const unsigned lanes = bits(nearer);
+            if (lanes == 0) {
+                continue;
+            }
+            t = select(nearer, ht, t);
+            u = select(nearer, hu, u);
+            v = select(nearer, hv, v);
+            for (size_t l = 0; l < Lanes::WIDTH; ++l) {
+                if (lanes & (1u << l)) {
+                    hit[l] = tri.m_id;
+                }
+            }
+        }
+    }
+    t.store(packet.m_t);
+    u.store(packet.m_u);
+    v.store(packet.m_v);
+    std::copy(hit, hit + Lanes::WIDTH, packet.m_triangle);
+}
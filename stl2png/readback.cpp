@@ -0,0 +1,102 @@
+#include "readback.h"
+#include <algorithm>
+
+namespace Graphics {
+
+namespace {
+// glClientWaitSync timeout per try, in nanoseconds
+const GLuint64 FENCE_WAIT_NS = 1000 * 1000;
+}  // namespace
+
+ReadbackRing::~ReadbackRing() {
+    for (auto& slot : m_slots) {
+        unmap(slot);
+        if (slot.m_fence) {
+            glDeleteSync(slot.m_fence);
+        }
+        glDeleteBuffers(1, &slot.m_buffer);
+    }
+}
+
+bool ReadbackRing::supported() { return GLAD_GL_VERSION_3_2 != 0; }
+
+void ReadbackRing::init(size_t count) {
+    m_slots.resize(std::max<size_t>(count, 2));
+    for (auto& slot : m_slots) {
+        glGenBuffers(1, &slot.m_buffer);
+    }
+}
+
+void ReadbackRing::unmap(Slot& slot) {
+    if (slot.m_mapped) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.m_buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.m_mapped = false;
+    }
+}
+
+size_t ReadbackRing::read(int x, int y, int width, int height, int channels) {
+    const size_t index = m_next;
+    m_next = (m_next + 1) % m_slots.size();
+    Slot& slot = m_slots[index];
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_released.wait(lock, [&slot]() { return !slot.m_in_use; });
+        slot.m_in_use = true;
+    }
+    unmap(slot);
+
+    const size_t size = size_t(width) * height * channels;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.m_buffer);
+    if (slot.m_size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.m_size = size;
+    }
+    slot.m_width = width;
+    slot.m_height = height;
+    slot.m_channels = channels;
+    // with a pack buffer bound the pointer is an offset into it and the copy is queued instead of waited for
+    glReadPixels(x, y, width, height, channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return index;
+}
+
+Image ReadbackRing::map(size_t index) {
+    Slot& slot = m_slots[index];
+    if (slot.m_fence) {
+        GLenum status = GL_TIMEOUT_EXPIRED;
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(slot.m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+        }
+        glDeleteSync(slot.m_fence);
+        slot.m_fence = nullptr;
+    }
+
+    Image image;
+    image.m_width = slot.m_width;
+    image.m_height = slot.m_height;
+    image.m_channels = slot.m_channels;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.m_buffer);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.m_size, GL_MAP_READ_BIT);
+    if (mapped) {
+        image.m_mapped = static_cast<const uint8_t*>(mapped);
+        slot.m_mapped = true;
+    } else {
+        // copy out instead when mapping fails
+        image.m_pixels.resize(slot.m_size);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, slot.m_size, image.m_pixels.data());
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return image;
+}
+
+void ReadbackRing::release(size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_slots[index].m_in_use = false;
+    }
+    m_released.notify_all();
+}
+}  // namespace Graphics
@@ -0,0 +1,60 @@
+#pragma once
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "image.h"
+
+namespace Graphics {
+
+// Ring of pixel pack buffers reading the framebuffer back asynchronously. read() starts the copy into the next
+// buffer and fences it, map() waits for the fence and returns an image pointing straight into the mapped buffer,
+// which stays valid until release(). The GL calls must be made on the context thread, release() can be called from
+// any thread. The buffers are reused round robin, read() waits for the images of a buffer to be released.
+class ReadbackRing {
+   public:
+    ReadbackRing() = default;
+    ~ReadbackRing();
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    // needs fence sync objects, GL 3.2
+    static bool supported();
+
+    // at least two buffers, one is mapped while the next is read
+    void init(size_t count);
+    bool is_initialized() const { return !m_slots.empty(); }
+
+    // starts reading the RGBA or RGB framebuffer into the next buffer, returns the slot to map
+    size_t read(int width, int height, int channels = 4) { return read(0, 0, width, height, channels); }
+
+    // the same for a region of the framebuffer
+    size_t read(int x, int y, int width, int height, int channels);
+
+    Image map(size_t slot);
+
+    void release(size_t slot);
+
+   private:
+    struct Slot {
+        GLuint m_buffer = 0;
+        GLsync m_fence = nullptr;
+        size_t m_size = 0;
+        int m_width = 0;
+        int m_height = 0;
+        int m_channels = 4;
+        // read or mapped and not yet released, guarded by m_mutex
+        bool m_in_use = false;
+        // only touched on the context thread
+        bool m_mapped = false;
+    };
+
+    void unmap(Slot& slot);
+
+    std::vector<Slot> m_slots;
+    size_t m_next = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+};
+}  // namespace Graphics
@@ -0,0 +1,621 @@
+#include "renderer.h"
+#ifdef STL2PNG_GLFW
+#include <GLFW/glfw3.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/component_wise.hpp>
+
+namespace {
+bool file_to_string(const std::string& file, std::string& str) {
+    if (std::ifstream fs = std::ifstream(file)) {
+        str = std::string((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+        return true;
+    } else {
+        return false;
+    }
+}
+}  // namespace
+
+namespace Graphics {
+
+// defines are inserted after the #version line, the appended file goes at the end without its #version line
+bool compileGLSLShaderFromFile(const std::string& file, GLint type, GLuint& shader_object,
+                               const std::string& defines = std::string(),
+                               const std::string& appended = std::string()) {
+    std::string shader_code;
+    if (::file_to_string(file, shader_code) == false) {
+        fprintf(stderr, "Failed to read %s", file.c_str());
+        return false;
+    }
+    if (!defines.empty()) {
+        const size_t line_end = shader_code.find('\n');
+        shader_code.insert(line_end == std::string::npos ? shader_code.size() : line_end + 1, defines);
+    }
+    if (!appended.empty()) {
+        std::string appended_code;
+        if (::file_to_string(appended, appended_code) == false) {
+            fprintf(stderr, "Failed to read %s", appended.c_str());
+            return false;
+        }
+        if (appended_code.compare(0, 8, "#version") == 0) {
+            const size_t line_end = appended_code.find('\n');
+            appended_code.erase(0, line_end == std::string::npos ? appended_code.size() : line_end + 1);
+        }
+        shader_code += "\n" + appended_code;
+    }
+    GLint shader_code_len = static_cast<GLint>(shader_code.size());
+    const GLchar* shader_string[] = {nullptr};
+    shader_string[0] = shader_code.data();
+    shader_object = glCreateShader(type);
+    glShaderSource(shader_object, 1, shader_string, &shader_code_len);
+    glCompileShader(shader_object);
+
+    GLint params = GL_FALSE;
+    glGetShaderiv(shader_object, GL_COMPILE_STATUS, &params);
+    if (params != GL_TRUE) {
+        GLint maxLength = 0;
+        glGetShaderiv(shader_object, GL_INFO_LOG_LENGTH, &maxLength);
+        std::vector<GLchar> errorLog(maxLength);
+        glGetShaderInfoLog(shader_object, maxLength, &maxLength, &errorLog[0]);
+        fprintf(stderr, "(%s) Shader compilation error: %s", file.c_str(), errorLog.data());
+        return false;
+    }
+    return true;
+}
+
+std::array<View, 7> make_views(const GLModel& uploaded) {
+    using glm::mat4;
+    using glm::vec3;
+    // Figure out a model to world matrix that normalizes the model scale and center
+    float scale = 2.f / glm::compMax(uploaded.m_max - uploaded.m_min);
+    vec3 translate = -uploaded.m_center;
+    mat4 model_T = glm::translate(mat4(1.f), translate);
+    mat4 model_S = glm::scale(mat4(1.f), vec3(scale));
+    mat4 model = model_S * model_T;
+
+    float vd = 4.f;
+    using glm::lookAt;
+    return {
+        View{lookAt(vec3(vd, 0.f, 0.f), vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(vd, 0.f, 0.f),  true, "px"},
+        View{lookAt(vec3(-vd, 0.f, 0.f),vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(-vd, 0.f, 0.f), true, "nx"},
+        View{lookAt(vec3(0.f, vd, 0.f), vec3(0.f), vec3(0.f, 0.f, 1.f)), model, vec3(0.f, vd, 0.f),  true, "py"},
+        View{lookAt(vec3(0.f, -vd, 0.f),vec3(0.f), vec3(0.f, 0.f, 1.f)), model, vec3(0.f, -vd, 0.f), true, "ny"},
+        View{lookAt(vec3(0.f, 0.f, vd), vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(0.f, 0.f, vd),  true, "pz"},
+        View{lookAt(vec3(0.f, 0.f, -vd),vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(0.f, 0.f, -vd), true, "nz"},
+        View{lookAt(vec3(vd, vd, vd),   vec3(0.f), vec3(0.f, 1.f, 0.f)), model, vec3(vd, vd, vd),   false, "or"},
+    };
+}
+
+glm::mat4 projection(const View& view, float ratio) {
+    if (view.m_perspective) {
+        return glm::perspective(45.0f, ratio, 0.1f, 100.f);
+    }
+    float os = 2.5;
+    return glm::ortho(-os * ratio, os * ratio, -os, os, 0.f, 100.f);
+}
+
+AtlasLayout make_atlas_layout(size_t views, int tile_width, int tile_height) {
+    AtlasLayout layout;
+    layout.m_rows = std::max(1, int(std::sqrt(double(views))));
+    layout.m_columns = std::max(1, int((views + layout.m_rows - 1) / layout.m_rows));
+    layout.m_tile_width = tile_width;
+    layout.m_tile_height = tile_height;
+    return layout;
+}
+
+GLRenderer::~GLRenderer() {
+    if (m_context) {
+        m_target.release();
+        m_atlas.release();
+        m_visibility.release();
+        if (m_multiview_program) {
+            glDeleteProgram(m_multiview_program);
+        }
+        if (m_resolve_program) {
+            glDeleteProgram(m_prepass_program);
+            glDeleteProgram(m_resolve_program);
+            glDeleteTextures(1, &m_vertex_texture);
+            glDeleteTextures(1, &m_index_texture);
+        }
+        if (m_depth_program) {
+            glDeleteProgram(m_depth_program);
+        }
+        for (const auto& timed : m_timed_passes) {
+            m_free_queries.push_back(timed.first);
+        }
+        if (!m_free_queries.empty()) {
+            glDeleteQueries(GLsizei(m_free_queries.size()), m_free_queries.data());
+        }
+        glDeleteBuffers(1, &m_vertex_buffer);
+        glDeleteBuffers(1, &m_index_buffer);
+        glDeleteProgram(m_program);
+        // the GL objects go while the context is still current
+        m_context.reset();
+    }
+}
+
+bool GLRenderer::init(bool windowed, ContextBackend backend) {
+    m_context = create_context(backend, windowed);
+    if (!m_context) {
+        return false;
+    }
+
+    GLuint vertex_shader, fragment_shader;
+    if (compileGLSLShaderFromFile("vertex.glsl", GL_VERTEX_SHADER, vertex_shader) == false) {
+        return false;
+    }
+    if (compileGLSLShaderFromFile("fragment.glsl", GL_FRAGMENT_SHADER, fragment_shader) == false) {
+        return false;
+    }
+    m_program = glCreateProgram();
+    glAttachShader(m_program, vertex_shader);
+    glAttachShader(m_program, fragment_shader);
+    glLinkProgram(m_program);
+    GLint params = GL_FALSE;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &params);
+    if (params != GL_TRUE) {
+        fputs("Failed to link shader program", stderr);
+        return false;
+    }
+    // the program keeps them
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    m_mvp_location = glGetUniformLocation(m_program, "MVP");
+    m_eye_location = glGetUniformLocation(m_program, "Eye");
+    m_model_location = glGetUniformLocation(m_program, "M");
+    m_position_location = glGetAttribLocation(m_program, "vPosition");
+    m_normal_location = glGetAttribLocation(m_program, "vNormal");
+
+    glGenBuffers(1, &m_vertex_buffer);
+    glGenBuffers(1, &m_index_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+    // RGB rows are packed without padding, as Image::stride() expects
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    return true;
+}
+
+bool GLRenderer::resize_target(int width, int height, DepthFormat depth) {
+    m_depth_format = depth;
+    return m_target.resize(width, height, depth);
+}
+
+bool GLRenderer::init_multiview() {
+    if (!GLAD_GL_VERSION_4_1) {
+        fputs("Multiview rendering needs OpenGL 4.1\n", stderr);
+        return false;
+    }
+    GLint invocations = 0, viewports = 0;
+    glGetIntegerv(GL_MAX_GEOMETRY_SHADER_INVOCATIONS, &invocations);
+    glGetIntegerv(GL_MAX_VIEWPORTS, &viewports);
+    if (invocations < GLint(m_views.size()) || viewports < GLint(m_views.size())) {
+        fputs("Multiview rendering needs a viewport and geometry shader invocation per view\n", stderr);
+        return false;
+    }
+    // vertex.glsl with identity transforms passes the model space position on in gl_Position
+    const std::string renamed = "#define color v_color\n#define normal v_normal\n#define vert2eye v_vert2eye\n";
+    GLuint shaders[3];
+    if (compileGLSLShaderFromFile("vertex.glsl", GL_VERTEX_SHADER, shaders[0], renamed) == false) {
+        return false;
+    }
+    if (compileGLSLShaderFromFile("multiview.glsl", GL_GEOMETRY_SHADER, shaders[1]) == false) {
+        glDeleteShader(shaders[0]);
+        return false;
+    }
+    if (compileGLSLShaderFromFile("fragment.glsl", GL_FRAGMENT_SHADER, shaders[2]) == false) {
+        glDeleteShader(shaders[0]);
+        glDeleteShader(shaders[1]);
+        return false;
+    }
+    m_multiview_program = glCreateProgram();
+    for (GLuint shader : shaders) {
+        glAttachShader(m_multiview_program, shader);
+    }
+    // the vertex attributes are set up for the main program
+    glBindAttribLocation(m_multiview_program, m_position_location, "vPosition");
+    glBindAttribLocation(m_multiview_program, m_normal_location, "vNormal");
+    glLinkProgram(m_multiview_program);
+    for (GLuint shader : shaders) {
+        glDeleteShader(shader);
+    }
+    GLint params = GL_FALSE;
+    glGetProgramiv(m_multiview_program, GL_LINK_STATUS, &params);
+    if (params != GL_TRUE) {
+        fputs("Failed to link multiview shader program\n", stderr);
+        glDeleteProgram(m_multiview_program);
+        m_multiview_program = 0;
+        return false;
+    }
+    m_view_mvp_location = glGetUniformLocation(m_multiview_program, "ViewMVP");
+    m_view_model_location = glGetUniformLocation(m_multiview_program, "ViewM");
+    m_view_eye_location = glGetUniformLocation(m_multiview_program, "ViewEye");
+
+    glUseProgram(m_multiview_program);
+    const glm::mat4 identity(1.f);
+    glUniformMatrix4fv(glGetUniformLocation(m_multiview_program, "MVP"), 1, GL_FALSE, glm::value_ptr(identity));
+    glUniformMatrix4fv(glGetUniformLocation(m_multiview_program, "M"), 1, GL_FALSE, glm::value_ptr(identity));
+    return true;
+}
+
+// Links the shaders into a program with the vertex attributes at the locations of the main program, deleting the
+// shaders. 0 when linking fails.
+GLuint link_program(const GLuint* shaders, size_t count, GLint position_location, GLint normal_location,
+                    const char* name) {
+    GLuint program = glCreateProgram();
+    for (size_t i = 0; i < count; ++i) {
+        glAttachShader(program, shaders[i]);
+    }
+    if (position_location >= 0) {
+        glBindAttribLocation(program, position_location, "vPosition");
+    }
+    if (normal_location >= 0) {
+        glBindAttribLocation(program, normal_location, "vNormal");
+    }
+    glLinkProgram(program);
+    for (size_t i = 0; i < count; ++i) {
+        glDeleteShader(shaders[i]);
+    }
+    GLint params = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &params);
+    if (params != GL_TRUE) {
+        fprintf(stderr, "Failed to link %s shader program\n", name);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool GLRenderer::init_visibility() {
+    GLuint prepass[2];
+    if (compileGLSLShaderFromFile("vertex.glsl", GL_VERTEX_SHADER, prepass[0]) == false) {
+        return false;
+    }
+    if (compileGLSLShaderFromFile("visibility.glsl", GL_FRAGMENT_SHADER, prepass[1], "#define PREPASS\n") == false) {
+        glDeleteShader(prepass[0]);
+        return false;
+    }
+    m_prepass_program = link_program(prepass, 2, m_position_location, m_normal_location, "visibility prepass");
+    if (m_prepass_program == 0) {
+        return false;
+    }
+    // fragment.glsl shades the pixels as a function called by the main of visibility.glsl appended to it
+    GLuint resolve[2];
+    if (compileGLSLShaderFromFile("visibility.glsl", GL_VERTEX_SHADER, resolve[0], "#define FULLSCREEN\n") == false ||
+        compileGLSLShaderFromFile("fragment.glsl", GL_FRAGMENT_SHADER, resolve[1],
+                                  "#define VISIBILITY_BUFFER\n#define RESOLVE\n#define main shade_fragment\n",
+                                  "visibility.glsl") == false) {
+        glDeleteShader(resolve[0]);
+        glDeleteProgram(m_prepass_program);
+        m_prepass_program = 0;
+        return false;
+    }
+    m_resolve_program = link_program(resolve, 2, -1, -1, "visibility resolve");
+    if (m_resolve_program == 0) {
+        glDeleteProgram(m_prepass_program);
+        m_prepass_program = 0;
+        return false;
+    }
+    m_prepass_mvp_location = glGetUniformLocation(m_prepass_program, "MVP");
+    m_resolve_mvp_location = glGetUniformLocation(m_resolve_program, "MVP");
+    m_resolve_model_location = glGetUniformLocation(m_resolve_program, "M");
+    m_resolve_eye_location = glGetUniformLocation(m_resolve_program, "Eye");
+    m_resolve_viewport_location = glGetUniformLocation(m_resolve_program, "Viewport");
+    m_resolve_compact_location = glGetUniformLocation(m_resolve_program, "Compact");
+    m_resolve_indexed_location = glGetUniformLocation(m_resolve_program, "Indexed");
+    // samplers of different types need texture units of their own
+    glUseProgram(m_resolve_program);
+    glUniform1i(glGetUniformLocation(m_resolve_program, "Triangles"), 0);
+    glUniform1i(glGetUniformLocation(m_resolve_program, "Vertices"), 1);
+    glUniform1i(glGetUniformLocation(m_resolve_program, "CompactVertices"), 2);
+    glUniform1i(glGetUniformLocation(m_resolve_program, "Indices"), 3);
+    glGenTextures(1, &m_vertex_texture);
+    glGenTextures(1, &m_index_texture);
+    return true;
+}
+
+bool GLRenderer::init_depth_prepass() {
+    GLuint vertex_shader;
+    if (compileGLSLShaderFromFile("vertex.glsl", GL_VERTEX_SHADER, vertex_shader) == false) {
+        return false;
+    }
+    // without a fragment shader, the color writes are off anyway
+    m_depth_program = link_program(&vertex_shader, 1, m_position_location, m_normal_location, "depth prepass");
+    if (m_depth_program == 0) {
+        return false;
+    }
+    m_depth_mvp_location = glGetUniformLocation(m_depth_program, "MVP");
+    return true;
+}
+
+bool GLRenderer::time_passes() {
+    if (!GLAD_GL_VERSION_3_3) {
+        fputs("Timing the passes needs OpenGL 3.3\n", stderr);
+        return false;
+    }
+    m_time_passes = true;
+    return true;
+}
+
+void GLRenderer::begin_pass(Pass pass) {
+    if (!m_time_passes) {
+        return;
+    }
+    GLuint query = 0;
+    if (m_free_queries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = m_free_queries.back();
+        m_free_queries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    m_timed_passes.emplace_back(query, pass);
+}
+
+void GLRenderer::end_pass() {
+    if (m_time_passes) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+}
+
+PassTimes GLRenderer::pass_times() {
+    PassTimes times;
+    for (const auto& timed : m_timed_passes) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(timed.first, GL_QUERY_RESULT, &nanoseconds);
+        (timed.second == Pass::Prepass ? times.m_prepass_ms : times.m_shading_ms) += double(nanoseconds) * 1e-6;
+        m_free_queries.push_back(timed.first);
+    }
+    m_timed_passes.clear();
+    return times;
+}
+
+bool GLRenderer::upload(LoadedModel& model, const RenderOptions& opts, ThreadPool& pool) {
+    if (upload_model(model, opts, pool, m_model) == false) {
+        return false;
+    }
+    if (m_model.m_compact) {
+        set_vertex_attributes<CompactVert>(m_position_location, m_normal_location);
+    } else {
+        set_vertex_attributes<Vert>(m_position_location, m_normal_location);
+    }
+    if (m_resolve_program) {
+        // a Vert is two RGB32F texels and a CompactVert one RGB32UI texel, both 12 bytes
+        GLint64 vertex_bytes = 0;
+        glGetBufferParameteri64v(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertex_bytes);
+        GLint max_texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+        const bool fits = vertex_bytes / 12 <= max_texels && m_model.m_count <= max_texels;
+        // once for every model that does not fit, whatever the model before it did
+        if (!fits) {
+            fputs("Model too large for the visibility buffer, shading every fragment instead\n", stderr);
+        }
+        m_visibility_fits = fits;
+        glBindTexture(GL_TEXTURE_BUFFER, m_vertex_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, m_model.m_compact ? GL_RGB32UI : GL_RGB32F, m_vertex_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, m_index_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, m_model.m_index_type == GL_UNSIGNED_SHORT ? GL_R16UI : GL_R32UI,
+                    m_index_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    m_views = make_views(m_model);
+    return true;
+}
+
+void GLRenderer::draw(const View& view, int width, int height) {
+    if (m_target.width() > 0) {
+        m_target.bind();
+    } else {
+        Framebuffer::unbind();
+    }
+    draw(view, 0, 0, width, height);
+}
+
+void GLRenderer::view_transforms(const View& view, float ratio, glm::mat4& mvp, glm::mat4& model) const {
+    const glm::mat4 dequant = m_model.dequantization();
+    mvp = projection(view, ratio) * view.m_viewMat * view.m_modelMat * dequant;
+    // vertex.glsl applies M from the left, so the dequantisation goes in transposed on that side
+    model = glm::transpose(dequant) * view.m_modelMat;
+}
+
+void GLRenderer::draw_model() const {
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+    if (m_model.m_index_type == GL_NONE) {
+        glDrawArrays(GL_TRIANGLES, 0, m_model.m_count);
+    } else {
+        glDrawElements(GL_TRIANGLES, m_model.m_count, m_model.m_index_type, nullptr);
+    }
+}
+
+void GLRenderer::draw(const View& view, int x, int y, int width, int height) {
+    glm::mat4 mvp, model;
+    view_transforms(view, width / (float)height, mvp, model);
+    glViewport(x, y, width, height);
+    // the viewport does not limit clears
+    glScissor(x, y, width, height);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    if (m_resolve_program && m_visibility_fits && draw_visibility(view, mvp, model, x, y, width, height)) {
+        return;
+    }
+    if (m_depth_program) {
+        // the nearest depth first, so the shading pass runs fragment.glsl only where it is equal
+        glUseProgram(m_depth_program);
+        glUniformMatrix4fv(m_depth_mvp_location, 1, GL_FALSE, glm::value_ptr(mvp));
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        begin_pass(Pass::Prepass);
+        draw_model();
+        end_pass();
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+    glUseProgram(m_program);
+    glUniformMatrix4fv(m_mvp_location, 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniform3fv(m_eye_location, 1, glm::value_ptr(view.m_eyeVec));
+    glUniformMatrix4fv(m_model_location, 1, GL_FALSE, glm::value_ptr(model));
+    begin_pass(Pass::Shading);
+    draw_model();
+    end_pass();
+    if (m_depth_program) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+}
+
+bool GLRenderer::draw_visibility(const View& view, const glm::mat4& mvp, const glm::mat4& model, int x, int y,
+                                 int width, int height) {
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    // the size of a view, the atlas tiles share it
+    const bool resized = m_visibility.resize(width, height, m_depth_format, GL_R32UI);
+    if (resized) {
+        m_visibility.bind();
+        glViewport(0, 0, width, height);
+        const GLuint none = 0;
+        glClearBufferuiv(GL_COLOR, 0, &none);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glUseProgram(m_prepass_program);
+        glUniformMatrix4fv(m_prepass_mvp_location, 1, GL_FALSE, glm::value_ptr(mvp));
+        begin_pass(Pass::Prepass);
+        draw_model();
+        end_pass();
+    } else {
+        fputs("Shading every fragment instead\n", stderr);
+        m_visibility_fits = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(framebuffer));
+    glViewport(x, y, width, height);
+    if (!resized) {
+        return false;
+    }
+
+    // a full screen triangle, pixels without a triangle keep the clear color
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(m_resolve_program);
+    glUniformMatrix4fv(m_resolve_mvp_location, 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniformMatrix4fv(m_resolve_model_location, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform3fv(m_resolve_eye_location, 1, glm::value_ptr(view.m_eyeVec));
+    glUniform4f(m_resolve_viewport_location, float(x), float(y), float(width), float(height));
+    glUniform1i(m_resolve_compact_location, m_model.m_compact ? 1 : 0);
+    glUniform1i(m_resolve_indexed_location, m_model.m_index_type == GL_NONE ? 0 : 1);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_visibility.color_texture());
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, m_model.m_compact ? 0 : m_vertex_texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, m_model.m_compact ? m_vertex_texture : 0);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, m_index_texture);
+    glActiveTexture(GL_TEXTURE0);
+    begin_pass(Pass::Shading);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    end_pass();
+    return true;
+}
+
+void GLRenderer::framebuffer_size(int& width, int& height) const {
+    if (m_target.width() > 0) {
+        width = m_target.width();
+        height = m_target.height();
+#ifdef STL2PNG_GLFW
+    } else if (m_context && m_context->window()) {
+        glfwGetFramebufferSize(m_context->window(), &width, &height);
+#endif
+    } else {
+        width = height = 0;
+    }
+}
+
+Image GLRenderer::read_view(const View& view, int channels) {
+    int width{0}, height{0};
+    framebuffer_size(width, height);
+    draw(view, width, height);
+    return read_region(0, 0, width, height, channels);
+}
+
+bool GLRenderer::draw_atlas(const AtlasLayout& layout) {
+    if (m_atlas.resize(layout.width(), layout.height(), m_depth_format) == false) {
+        return false;
+    }
+    m_atlas.bind();
+    glViewport(0, 0, layout.width(), layout.height());
+    glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+    // the visibility buffer and the depth prepass draw a view at a time
+    if (m_multiview_program == 0 || (m_resolve_program && m_visibility_fits) || m_depth_program) {
+        // for the empty tiles
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (size_t v = 0; v < m_views.size(); ++v) {
+            draw(m_views[v], layout.tile_x(v), layout.tile_y(v), layout.m_tile_width, layout.m_tile_height);
+        }
+        return true;
+    }
+
+    // one clear and one draw, the geometry shader sends each view to its viewport
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    const size_t count = m_views.size();
+    std::array<glm::mat4, 7> mvps, models;
+    for (size_t v = 0; v < count; ++v) {
+        view_transforms(m_views[v], layout.m_tile_width / (float)layout.m_tile_height, mvps[v], models[v]);
+        glViewportIndexedf(GLuint(v), float(layout.tile_x(v)), float(layout.tile_y(v)), float(layout.m_tile_width),
+                           float(layout.m_tile_height));
+    }
+    glUseProgram(m_multiview_program);
+    glUniformMatrix4fv(m_view_mvp_location, GLsizei(count), GL_FALSE, glm::value_ptr(mvps[0]));
+    glUniformMatrix4fv(m_view_model_location, GLsizei(count), GL_FALSE, glm::value_ptr(models[0]));
+    std::array<glm::vec3, 7> eyes;
+    for (size_t v = 0; v < count; ++v) {
+        eyes[v] = m_views[v].m_eyeVec;
+    }
+    glUniform3fv(m_view_eye_location, GLsizei(count), glm::value_ptr(eyes[0]));
+    begin_pass(Pass::Shading);
+    draw_model();
+    end_pass();
+    return true;
+}
+
+bool GLRenderer::read_atlas(const AtlasLayout& layout, int channels, Image& image) {
+    if (draw_atlas(layout) == false) {
+        return false;
+    }
+    image = read_region(0, 0, layout.width(), layout.height(), channels);
+    return true;
+}
+
+Image GLRenderer::read_region(int x, int y, int width, int height, int channels) const {
+    Image image;
+    image.m_width = width;
+    image.m_height = height;
+    image.m_channels = channels;
+    image.m_pixels.resize(size_t(image.stride()) * image.m_height);
+    glReadPixels(x, y, width, height, channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, image.m_pixels.data());
+    return image;
+}
+
+void GLRenderer::show() {
+#ifdef STL2PNG_GLFW
+    // show a window cycling through the views, showing each for a set number of frames
+    signed count = 0;
+    signed frames_per_view = 100;
+    GLFWwindow* window = m_context->window();
+    while (!glfwWindowShouldClose(window)) {
+        int width{0}, height{0};
+        glfwGetFramebufferSize(window, &width, &height);
+        draw(m_views[count / frames_per_view], width, height);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        ++count;
+        count %= (frames_per_view * m_views.size());
+    }
+#endif
+}
+}  // namespace Graphics
@@ -0,0 +1,176 @@
+#pragma once
+#include <glad/glad.h>
+#include <array>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "context.h"
+#include "framebuffer.h"
+#include "image.h"
+#include "model.h"
+#include "options.h"
+#include "thread_pool.h"
+
+namespace Graphics {
+
+struct View {
+    glm::mat4 m_viewMat;
+    glm::mat4 m_modelMat;
+    glm::vec3 m_eyeVec;
+    bool m_perspective = true;
+    std::string m_viewName;
+};
+
+// The six axis views and an orthographic corner view of a model, normalized to a unit scale around its center.
+std::array<View, 7> make_views(const GLModel& model);
+
+// The projection of vertex.glsl for a view at the aspect ratio, perspective or orthographic.
+glm::mat4 projection(const View& view, float ratio);
+
+// All views in one image, a grid of equally sized tiles filled row by row from the first row in memory.
+struct AtlasLayout {
+    int m_columns = 0;
+    int m_rows = 0;
+    int m_tile_width = 0;
+    int m_tile_height = 0;
+
+    int width() const { return m_columns * m_tile_width; }
+    int height() const { return m_rows * m_tile_height; }
+    // first column and row of the tile of a view
+    int tile_x(size_t view) const { return int(view % m_columns) * m_tile_width; }
+    int tile_y(size_t view) const { return int(view / m_columns) * m_tile_height; }
+};
+
+// a close to square grid with the fewest empty tiles, two rows of four for the seven views
+AtlasLayout make_atlas_layout(size_t views, int tile_width, int tile_height);
+
+// GPU time of the passes drawing views, from GL timer queries
+struct PassTimes {
+    // the depth or visibility prepass, none when shading forward
+    double m_prepass_ms = 0.0;
+    // the pass running fragment.glsl, the full screen pass of the visibility buffer
+    double m_shading_ms = 0.0;
+};
+
+// Owns the GL context, shader program and buffers. Created once and reused for every model rendered, each
+// upload replaces the contents of the buffers.
+class GLRenderer {
+   public:
+    GLRenderer() = default;
+    ~GLRenderer();
+    GLRenderer(const GLRenderer&) = delete;
+    GLRenderer& operator=(const GLRenderer&) = delete;
+
+    // Creates the context, compiles vertex.glsl and fragment.glsl and creates the buffers. Headless renderers draw
+    // offscreen into the target set by resize_target(), with any backend. Windowed ones need a GLFW window.
+    bool init(bool windowed, ContextBackend backend = ContextBackend::GLFW);
+
+    // creates the offscreen framebuffer headless views are drawn into
+    bool resize_target(int width, int height, DepthFormat depth);
+    bool is_initialized() const { return m_context != nullptr; }
+
+    // Compiles vertex.glsl, multiview.glsl and fragment.glsl into the program draw_atlas() uses to draw all views in
+    // a single pass. Needs GL 4.1 for viewport arrays, false leaves draw_atlas() drawing a view at a time.
+    bool init_multiview();
+
+    // Compiles the programs of the visibility buffer from vertex.glsl, visibility.glsl and fragment.glsl, before
+    // uploading. Views are then drawn with a prepass writing the triangle of each pixel and a full screen pass
+    // shading every covered pixel once, one view at a time. False keeps shading every fragment as it is drawn.
+    bool init_visibility();
+
+    // Compiles vertex.glsl alone into a depth only program. Views are then drawn with a prepass writing only the
+    // depth and a GL_EQUAL pass running fragment.glsl once per pixel, one view at a time.
+    bool init_depth_prepass();
+
+    // Times the passes of the views drawn with timer queries, needs OpenGL 3.3.
+    bool time_passes();
+
+    // the GPU time of the passes drawn since the last call, waits for the GL to finish them
+    PassTimes pass_times();
+
+    // loads the model into the buffers and points the vertex attributes at them
+    bool upload(LoadedModel& model, const RenderOptions& opts, ThreadPool& pool);
+
+    // draws the view into the whole of the offscreen target, or the window without one
+    void draw(const View& view, int width, int height);
+
+    // draws the view into a region of the framebuffer, leaving the rest of it as it is
+    void draw(const View& view, int x, int y, int width, int height);
+
+    // size of the offscreen target, or the window framebuffer without one
+    void framebuffer_size(int& width, int& height) const;
+
+    const std::array<View, 7>& views() const { return m_views; }
+
+    // draws a view of the uploaded model into the offscreen target and reads it back as RGBA or RGB
+    Image read_view(const View& view, int channels = 4);
+
+    // draws every view into its tile of an offscreen atlas framebuffer, which stays bound to be read back
+    bool draw_atlas(const AtlasLayout& layout);
+
+    // draws the atlas and reads it back as RGBA or RGB
+    bool read_atlas(const AtlasLayout& layout, int channels, Image& image);
+
+    // reads a region of the bound framebuffer back as RGBA or RGB
+    Image read_region(int x, int y, int width, int height, int channels) const;
+
+    // shows a window cycling through the views of the uploaded model until it is closed
+    void show();
+
+   private:
+    enum class Pass { Prepass, Shading };
+
+    // the transforms of vertex.glsl for a view at the aspect ratio
+    void view_transforms(const View& view, float ratio, glm::mat4& mvp, glm::mat4& model) const;
+    void draw_model() const;
+    // timer queries around the draws of a pass, when timing
+    void begin_pass(Pass pass);
+    void end_pass();
+    // the two passes of the visibility buffer into a region of the bound framebuffer, false when it can not be used
+    bool draw_visibility(const View& view, const glm::mat4& mvp, const glm::mat4& model, int x, int y, int width,
+                         int height);
+
+    std::unique_ptr<GLContext> m_context;
+    GLuint m_program = 0;
+    GLuint m_vertex_buffer = 0;
+    GLuint m_index_buffer = 0;
+    GLint m_mvp_location = -1;
+    GLint m_eye_location = -1;
+    GLint m_model_location = -1;
+    GLint m_position_location = -1;
+    GLint m_normal_location = -1;
+    GLuint m_multiview_program = 0;
+    GLint m_view_mvp_location = -1;
+    GLint m_view_model_location = -1;
+    GLint m_view_eye_location = -1;
+    GLuint m_prepass_program = 0;
+    GLint m_prepass_mvp_location = -1;
+    GLuint m_resolve_program = 0;
+    GLint m_resolve_mvp_location = -1;
+    GLint m_resolve_model_location = -1;
+    GLint m_resolve_eye_location = -1;
+    GLint m_resolve_viewport_location = -1;
+    GLint m_resolve_compact_location = -1;
+    GLint m_resolve_indexed_location = -1;
+    // the vertex and element buffers as buffer textures the resolve pass fetches the triangles from
+    GLuint m_vertex_texture = 0;
+    GLuint m_index_texture = 0;
+    // whether the buffers of the uploaded model fit buffer textures
+    bool m_visibility_fits = false;
+    GLuint m_depth_program = 0;
+    GLint m_depth_mvp_location = -1;
+    bool m_time_passes = false;
+    // the timer queries of passes waiting to be read, and ones ready for reuse
+    std::vector<std::pair<GLuint, Pass>> m_timed_passes;
+    std::vector<GLuint> m_free_queries;
+    GLModel m_model;
+    std::array<View, 7> m_views;
+    DepthFormat m_depth_format = DepthFormat::Depth24;
+    Framebuffer m_target;
+    Framebuffer m_atlas;
+    Framebuffer m_visibility;
+};
+}  // namespace Graphics
@@ -0,0 +1,86 @@
+#include "shading.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Shading {
+
+namespace {
+const float PI = 3.14159f;
+const glm::vec3 LIGHT_DIRECTIONS[3] = {{1.f, 1.f, 0.5f}, {-1.f, 0.1f, -0.5f}, {-0.1f, -0.5f, -0.5f}};
+const glm::vec3 UNIT_LIGHT_DIRECTIONS[3] = {glm::normalize(LIGHT_DIRECTIONS[0]), glm::normalize(LIGHT_DIRECTIONS[1]),
+                                            glm::normalize(LIGHT_DIRECTIONS[2])};
+const glm::vec3 LIGHT_COLORS[3] = {{1.f, 1.f, 0.95f}, {0.1f, 0.1f, 0.2f}, {0.1f, 0.0f, 0.0f}};
+// the grey of vertex.glsl
+const float COLOR = 0.8f;
+const float IOR = 2.f;
+const float ROUGHNESS = 0.15f;
+// the dielectric reflectance at normal incidence, used to conserve energy in the diffuse part
+const float F0 = ((1.f - IOR) / (1.f + IOR)) * ((1.f - IOR) / (1.f + IOR));
+
+#define SIMD_KERNEL "shading_lanes.h"
+#include "simd_lanes.h"
+#undef SIMD_KERNEL
+}  // namespace
+
+glm::vec3 shade(const glm::vec3& normal, const glm::vec3& vert2eye) {
+    using glm::vec3;
+    vec3 diffuse(0.f);
+    for (int l = 0; l < 3; ++l) {
+        const float NdotL = glm::dot(normal, UNIT_LIGHT_DIRECTIONS[l]);
+        diffuse += (NdotL > 0.f ? (NdotL < 1.f ? NdotL : 1.f) : 0.f) * LIGHT_COLORS[l];
+    }
+
+    // Cook-Torrance with the unnormalized light directions of fragment.glsl. The material is fully metallic, so the
+    // Fresnel reflectance at normal incidence is the grey colour and the Schlick term the same for all channels.
+    const vec3 eye = glm::normalize(vert2eye);
+    const float NdotV = std::max(0.f, glm::dot(normal, eye));
+    const float F = COLOR + (1.f - COLOR) * std::pow(1.f - NdotV, 5.f);
+    const float alpha2 = ROUGHNESS * ROUGHNESS;
+    vec3 specular(0.f);
+    for (int l = 0; l < 3; ++l) {
+        const vec3& light = LIGHT_DIRECTIONS[l];
+        const float NdotL = std::max(0.f, glm::dot(normal, light));
+        if (NdotL > 0.f) {
+            const vec3 H = glm::normalize(light + eye);
+            // microfacet distribution
+            const float NoH = glm::dot(normal, H);
+            const float NoH2 = NoH * NoH;
+            const float den = NoH2 * alpha2 + (1.f - NoH2);
+            const float D = (NoH > 0.f ? alpha2 : 0.f) / (PI * den * den);
+            // microfacet geometry, a zero NdotV makes chi NaN and so 0 like the GLSL
+            const float VoH = std::max(0.f, glm::dot(eye, H));
+            const float chi = VoH / NdotV > 0.f ? 1.f : 0.f;
+            const float VoH2 = VoH * VoH;
+            const float tan2 = (1.f - VoH2) / VoH2;
+            const float G = (chi * 2.f) / (1.f + std::sqrt(1.f + alpha2 * tan2));
+            specular += NdotL * LIGHT_COLORS[l] * ((D * F * G) / (PI * NdotL * NdotV));
+        }
+    }
+    return COLOR * (F0 * specular + (1.f - F0) * diffuse);
+}
+
+void shade(Fragments& fragments) { shade(fragments, SIMD::instructions()); }
+
+void shade(Fragments& fragments, SIMD::Instructions instructions) {
+    const size_t count = fragments.m_count;
+    // the rows have room to round up to whole vectors, the lanes past the end are ignored
+    switch (instructions) {
+#ifdef SIMD_X86
+        case SIMD::Instructions::AVX512:
+            avx512::shade_lanes(fragments, 0, count);
+            return;
+        case SIMD::Instructions::AVX2:
+            avx2::shade_lanes(fragments, 0, count);
+            return;
+        case SIMD::Instructions::SSE2:
+            sse2::shade_lanes(fragments, 0, count);
+            return;
+#endif
+        default:
+            scalar::shade_lanes(fragments, 0, count);
+            return;
+    }
+}
+
+const char* vector_instructions() { return SIMD::name(SIMD::instructions()); }
+}  // namespace Shading
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "simd.h"
+
+// The shading of vertex.glsl and fragment.glsl for the renderers running on the CPU.
+namespace Shading {
+
+// glClearColor(0.1f, 0.1f, 0.1f, 1.f) in an 8 bit framebuffer
+const uint8_t CLEAR = 26;
+
+// fragment.glsl for the interpolated normal and vector to the eye, the normal is used as interpolated like the GLSL.
+// One fragment at a time, the reference the tests hold the vector code to.
+glm::vec3 shade(const glm::vec3& normal, const glm::vec3& vert2eye);
+
+// Fragments waiting to be shaded in rows of components, filled by the renderer after visibility so every pixel is
+// shaded once. Too large for the stack.
+struct Fragments {
+    // a 64x64 tile, a multiple of the widest vector
+    static const size_t CAPACITY = 64 * 64;
+
+    alignas(64) float m_normal[3][CAPACITY];
+    alignas(64) float m_vert2eye[3][CAPACITY];
+    alignas(64) float m_color[3][CAPACITY];
+    size_t m_count = 0;
+};
+
+// Shades the fragments into m_color like shade(normal, vert2eye), 16 at a time with AVX-512, 8 with AVX2 and FMA or
+// 4 with SSE2 as the CPU allows. Within rounding of it, FMA and the order of operations differ.
+void shade(Fragments& fragments);
+
+// shade(Fragments&) with the given instruction set, which the CPU must support
+void shade(Fragments& fragments, SIMD::Instructions instructions);
+
+// the instruction set shade(Fragments&) uses on this CPU
+const char* vector_instructions();
+
+// a colour component as the GL stores it in an 8 bit framebuffer, clamped and rounded, NaN as 0
+inline uint8_t unorm8(float c) { return uint8_t((c > 0.f ? (c < 1.f ? c : 1.f) : 0.f) * 255.f + 0.5f); }
+}  // namespace Shading
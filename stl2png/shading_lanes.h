@@ -0,0 +1,65 @@
+// The vectorised fragment.glsl, the SIMD_KERNEL of shading.cpp compiled for each instruction set by simd_lanes.h.
+
+// shades the fragments [first, last) a vector at a time, last rounded up to whole vectors
+void shade_lanes(Fragments& fragments, size_t first, size_t last) {
+    const Lanes zero = Lanes::set(0.f), one = Lanes::set(1.f), two = Lanes::set(2.f);
+    const Lanes pi = Lanes::set(PI), alpha2 = Lanes::set(ROUGHNESS * ROUGHNESS);
+    const Lanes color = Lanes::set(COLOR), white = Lanes::set(1.f - COLOR);
+    for (size_t i = first; i < last; i += Lanes::WIDTH) {
+        const Lanes nx = Lanes::load(fragments.m_normal[0] + i);
+        const Lanes ny = Lanes::load(fragments.m_normal[1] + i);
+        const Lanes nz = Lanes::load(fragments.m_normal[2] + i);
+        Lanes ex = Lanes::load(fragments.m_vert2eye[0] + i);
+        Lanes ey = Lanes::load(fragments.m_vert2eye[1] + i);
+        Lanes ez = Lanes::load(fragments.m_vert2eye[2] + i);
+        const Lanes inv_length = one / sqrt(ex * ex + ey * ey + ez * ez);
+        ex = ex * inv_length;
+        ey = ey * inv_length;
+        ez = ez * inv_length;
+
+        Lanes diffuse[3] = {zero, zero, zero};
+        Lanes specular[3] = {zero, zero, zero};
+        const Lanes NdotV = max(zero, nx * ex + ny * ey + nz * ez);
+        const Lanes s = one - NdotV;
+        const Lanes F = color + white * (s * s) * (s * s) * s;
+        for (int l = 0; l < 3; ++l) {
+            const glm::vec3& unit = UNIT_LIGHT_DIRECTIONS[l];
+            const Lanes d = min(one, max(zero, nx * Lanes::set(unit.x) + ny * Lanes::set(unit.y) +
+                                                   nz * Lanes::set(unit.z)));
+            for (int c = 0; c < 3; ++c) {
+                diffuse[c] = diffuse[c] + d * Lanes::set(LIGHT_COLORS[l][c]);
+            }
+
+            const Lanes lx = Lanes::set(LIGHT_DIRECTIONS[l].x);
+            const Lanes ly = Lanes::set(LIGHT_DIRECTIONS[l].y);
+            const Lanes lz = Lanes::set(LIGHT_DIRECTIONS[l].z);
+            const Lanes NdotL = max(zero, nx * lx + ny * ly + nz * lz);
+            const Mask lit = NdotL > zero;
+            if (!any(lit)) {
+                continue;
+            }
+            Lanes hx = lx + ex, hy = ly + ey, hz = lz + ez;
+            const Lanes inv_h = one / sqrt(hx * hx + hy * hy + hz * hz);
+            hx = hx * inv_h;
+            hy = hy * inv_h;
+            hz = hz * inv_h;
+            const Lanes NoH = nx * hx + ny * hy + nz * hz;
+            const Lanes NoH2 = NoH * NoH;
+            const Lanes den = NoH2 * alpha2 + (one - NoH2);
+            const Lanes D = select(NoH > zero, alpha2, zero) / (pi * den * den);
+            const Lanes VoH = max(zero, ex * hx + ey * hy + ez * hz);
+            const Lanes chi = select(VoH / NdotV > zero, one, zero);
+            const Lanes VoH2 = VoH * VoH;
+            const Lanes tan2 = (one - VoH2) / VoH2;
+            const Lanes G = (chi * two) / (one + sqrt(one + alpha2 * tan2));
+            const Lanes response = select(lit, NdotL * ((D * F * G) / (pi * NdotL * NdotV)), zero);
+            for (int c = 0; c < 3; ++c) {
+                specular[c] = specular[c] + response * Lanes::set(LIGHT_COLORS[l][c]);
+            }
+        }
+        const Lanes f0 = Lanes::set(F0), kd = Lanes::set(1.f - F0);
+        for (int c = 0; c < 3; ++c) {
+            (color * (f0 * specular[c] + kd * diffuse[c])).store(fragments.m_color[c] + i);
+        }
+    }
+}
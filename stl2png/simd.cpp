@@ -0,0 +1,54 @@
+#include "simd.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SIMD {
+
+namespace {
+Instructions detect() {
+#if !defined(SIMD_X86)
+    return Instructions::None;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // AVX, FMA and OSXSAVE, then check the OS saves the YMM and for AVX-512 the ZMM registers
+    const bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    if (!avx) {
+        return Instructions::SSE2;
+    }
+    const unsigned long long saved = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 16)) && (saved & 0xe6) == 0xe6) {
+        return Instructions::AVX512;
+    }
+    return (info[1] & (1 << 5)) && fma && (saved & 6) == 6 ? Instructions::AVX2 : Instructions::SSE2;
+#else
+    if (__builtin_cpu_supports("avx512f")) {
+        return Instructions::AVX512;
+    }
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? Instructions::AVX2 : Instructions::SSE2;
+#endif
+}
+}  // namespace
+
+Instructions instructions() {
+    static const Instructions detected = detect();
+    return detected;
+}
+
+const char* name(Instructions instructions) {
+    switch (instructions) {
+        case Instructions::SSE2:
+            return "SSE2";
+        case Instructions::AVX2:
+            return "AVX2";
+        case Instructions::AVX512:
+            return "AVX-512";
+        case Instructions::None:
+            break;
+    }
+    return "scalar";
+}
+}  // namespace SIMD
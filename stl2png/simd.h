@@ -0,0 +1,24 @@
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The instruction sets of the kernels written once over the vectors of simd_lanes.h.
+namespace SIMD {
+
+enum class Instructions {
+    // the scalar code
+    None,
+    SSE2,
+    // with FMA
+    AVX2,
+    AVX512,
+};
+
+// the widest set both the CPU and the OS support, detected once
+Instructions instructions();
+
+const char* name(Instructions instructions);
+}  // namespace SIMD
@@ -0,0 +1,161 @@
+// Lanes, a vector of floats, and Mask, the lanes a comparison picked, for each instruction set in a namespace of its
+// own: sse2, avx2 and avx512, and scalar with a single lane for the rest. The kernel file named by SIMD_KERNEL is
+// included in each namespace after them and compiled for its set, so a kernel is written once over Lanes and called
+// as sse2::kernel() and so on. Included once per kernel, within the namespace of the caller, so there is no include
+// guard. Needs simd.h first.
+#ifndef SIMD_KERNEL
+#error SIMD_KERNEL names the kernel to compile for each instruction set
+#endif
+
+namespace scalar {
+struct Lanes {
+    static const size_t WIDTH = 1;
+    float m_v;
+    static Lanes load(const float* p) { return {*p}; }
+    static Lanes set(float f) { return {f}; }
+    void store(float* p) const { *p = m_v; }
+};
+struct Mask {
+    bool m_m;
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {a.m_v + b.m_v}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {a.m_v - b.m_v}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {a.m_v * b.m_v}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {a.m_v / b.m_v}; }
+// the operand order of minps and maxps, b when either is NaN
+inline Lanes min(Lanes a, Lanes b) { return {a.m_v < b.m_v ? a.m_v : b.m_v}; }
+inline Lanes max(Lanes a, Lanes b) { return {a.m_v > b.m_v ? a.m_v : b.m_v}; }
+inline Lanes sqrt(Lanes a) { return {std::sqrt(a.m_v)}; }
+inline Mask operator>(Lanes a, Lanes b) { return {a.m_v > b.m_v}; }
+inline Mask operator>=(Lanes a, Lanes b) { return {a.m_v >= b.m_v}; }
+inline Mask operator<(Lanes a, Lanes b) { return {a.m_v < b.m_v}; }
+inline Mask operator<=(Lanes a, Lanes b) { return {a.m_v <= b.m_v}; }
+inline Mask operator&(Mask a, Mask b) { return {a.m_m && b.m_m}; }
+inline Mask operator|(Mask a, Mask b) { return {a.m_m || b.m_m}; }
+inline Lanes select(Mask m, Lanes a, Lanes b) { return m.m_m ? a : b; }
+inline bool any(Mask m) { return m.m_m; }
+inline unsigned bits(Mask m) { return m.m_m ? 1u : 0u; }
+#include SIMD_KERNEL
+}  // namespace scalar
+
+#ifdef SIMD_X86
+namespace sse2 {
+struct Lanes {
+    static const size_t WIDTH = 4;
+    __m128 m_v;
+    static Lanes load(const float* p) { return {_mm_load_ps(p)}; }
+    static Lanes set(float f) { return {_mm_set1_ps(f)}; }
+    void store(float* p) const { _mm_store_ps(p, m_v); }
+};
+struct Mask {
+    __m128 m_m;
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.m_v, b.m_v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.m_v, b.m_v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.m_v, b.m_v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.m_v, b.m_v)}; }
+inline Lanes min(Lanes a, Lanes b) { return {_mm_min_ps(a.m_v, b.m_v)}; }
+inline Lanes max(Lanes a, Lanes b) { return {_mm_max_ps(a.m_v, b.m_v)}; }
+inline Lanes sqrt(Lanes a) { return {_mm_sqrt_ps(a.m_v)}; }
+inline Mask operator>(Lanes a, Lanes b) { return {_mm_cmpgt_ps(a.m_v, b.m_v)}; }
+inline Mask operator>=(Lanes a, Lanes b) { return {_mm_cmpge_ps(a.m_v, b.m_v)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {_mm_cmplt_ps(a.m_v, b.m_v)}; }
+inline Mask operator<=(Lanes a, Lanes b) { return {_mm_cmple_ps(a.m_v, b.m_v)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.m_m, b.m_m)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm_or_ps(a.m_m, b.m_m)}; }
+inline Lanes select(Mask m, Lanes a, Lanes b) {
+    return {_mm_or_ps(_mm_and_ps(m.m_m, a.m_v), _mm_andnot_ps(m.m_m, b.m_v))};
+}
+inline bool any(Mask m) { return _mm_movemask_ps(m.m_m) != 0; }
+// bit i set for lane i
+inline unsigned bits(Mask m) { return unsigned(_mm_movemask_ps(m.m_m)); }
+#include SIMD_KERNEL
+}  // namespace sse2
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+namespace avx2 {
+struct Lanes {
+    static const size_t WIDTH = 8;
+    __m256 m_v;
+    static Lanes load(const float* p) { return {_mm256_load_ps(p)}; }
+    static Lanes set(float f) { return {_mm256_set1_ps(f)}; }
+    void store(float* p) const { _mm256_store_ps(p, m_v); }
+};
+struct Mask {
+    __m256 m_m;
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.m_v, b.m_v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.m_v, b.m_v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.m_v, b.m_v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.m_v, b.m_v)}; }
+inline Lanes min(Lanes a, Lanes b) { return {_mm256_min_ps(a.m_v, b.m_v)}; }
+inline Lanes max(Lanes a, Lanes b) { return {_mm256_max_ps(a.m_v, b.m_v)}; }
+inline Lanes sqrt(Lanes a) { return {_mm256_sqrt_ps(a.m_v)}; }
+inline Mask operator>(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.m_v, b.m_v, _CMP_GT_OQ)}; }
+inline Mask operator>=(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.m_v, b.m_v, _CMP_GE_OQ)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.m_v, b.m_v, _CMP_LT_OQ)}; }
+inline Mask operator<=(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.m_v, b.m_v, _CMP_LE_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.m_m, b.m_m)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm256_or_ps(a.m_m, b.m_m)}; }
+inline Lanes select(Mask m, Lanes a, Lanes b) { return {_mm256_blendv_ps(b.m_v, a.m_v, m.m_m)}; }
+inline bool any(Mask m) { return _mm256_movemask_ps(m.m_m) != 0; }
+inline unsigned bits(Mask m) { return unsigned(_mm256_movemask_ps(m.m_m)); }
+#include SIMD_KERNEL
+}  // namespace avx2
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+// the intrinsics leave their unused merge source undefined on purpose
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+namespace avx512 {
+struct Lanes {
+    static const size_t WIDTH = 16;
+    __m512 m_v;
+    static Lanes load(const float* p) { return {_mm512_load_ps(p)}; }
+    static Lanes set(float f) { return {_mm512_set1_ps(f)}; }
+    void store(float* p) const { _mm512_store_ps(p, m_v); }
+};
+struct Mask {
+    __mmask16 m_m;
+};
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm512_add_ps(a.m_v, b.m_v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm512_sub_ps(a.m_v, b.m_v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm512_mul_ps(a.m_v, b.m_v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm512_div_ps(a.m_v, b.m_v)}; }
+inline Lanes min(Lanes a, Lanes b) { return {_mm512_min_ps(a.m_v, b.m_v)}; }
+inline Lanes max(Lanes a, Lanes b) { return {_mm512_max_ps(a.m_v, b.m_v)}; }
+inline Lanes sqrt(Lanes a) { return {_mm512_sqrt_ps(a.m_v)}; }
+inline Mask operator>(Lanes a, Lanes b) { return {_mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_GT_OQ)}; }
+inline Mask operator>=(Lanes a, Lanes b) { return {_mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_GE_OQ)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {_mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_LT_OQ)}; }
+inline Mask operator<=(Lanes a, Lanes b) { return {_mm512_cmp_ps_mask(a.m_v, b.m_v, _CMP_LE_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {__mmask16(a.m_m & b.m_m)}; }
+inline Mask operator|(Mask a, Mask b) { return {__mmask16(a.m_m | b.m_m)}; }
+inline Lanes select(Mask m, Lanes a, Lanes b) { return {_mm512_mask_blend_ps(m.m_m, b.m_v, a.m_v)}; }
+inline bool any(Mask m) { return m.m_m != 0; }
+inline unsigned bits(Mask m) { return unsigned(m.m_m); }
+#include SIMD_KERNEL
+}  // namespace avx512
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+#endif
@@ -0,0 +1,109 @@
+#include "software_renderer.h"
+#include <algorithm>
+#include "rasterizer.h"
+#include "raycaster.h"
+#include "shading.h"
+
+namespace Graphics {
+
+bool SoftwareRenderer::take_vertices(LoadedModel& model, const RenderOptions& opts) {
+    // streaming bounds the host memory of GL uploads, here all vertices are needed anyway
+    LoadedModel whole;
+    if (model.m_stream) {
+        RenderOptions loading = opts;
+        loading.m_stream = false;
+        if (load_model(model.m_file, loading, m_pool, whole) == false) {
+            return false;
+        }
+    }
+    LoadedModel& source = model.m_stream ? whole : model;
+    source.wait();
+    m_indices.clear();
+    if (opts.m_weld) {
+        Mesh::IndexedMesh mesh = weld_model(source.m_vertices, opts);
+        m_vertices.swap(mesh.m_vertices);
+        m_indices.swap(mesh.m_indices);
+    } else {
+        m_vertices.swap(source.m_vertices);
+    }
+    std::vector<Vert>().swap(source.m_vertices);
+    source.m_mapped.reset();
+    GLModel bounds;
+    bounds.m_min = source.m_min;
+    bounds.m_max = source.m_max;
+    bounds.m_center = source.m_center;
+    m_views = make_views(bounds);
+    return true;
+}
+
+void SoftwareRenderer::clear(uint8_t* pixels, size_t count, int channels) {
+    for (size_t i = 0; i < count; ++i, pixels += channels) {
+        pixels[0] = pixels[1] = pixels[2] = Shading::CLEAR;
+        if (channels == 4) {
+            pixels[3] = 255;
+        }
+    }
+}
+
+SoftwareRenderer::Tile SoftwareRenderer::clear_tile(Image& image, int x, int y, int width, int height, size_t tile,
+                                                   int columns, int size) {
+    Tile t;
+    t.m_size = size;
+    t.m_x0 = int(tile % columns) * size;
+    t.m_y0 = int(tile / columns) * size;
+    t.m_x1 = std::min(t.m_x0 + size, width) - 1;
+    t.m_y1 = std::min(t.m_y0 + size, height) - 1;
+    t.m_channels = image.m_channels;
+    t.m_stride = size_t(image.stride());
+    t.m_origin = image.m_pixels.data() + size_t(y + t.m_y0) * t.m_stride + size_t(x + t.m_x0) * t.m_channels;
+    for (int py = t.m_y0; py <= t.m_y1; ++py) {
+        clear(t.m_origin + (py - t.m_y0) * t.m_stride, size_t(t.m_x1 - t.m_x0 + 1), t.m_channels);
+    }
+    return t;
+}
+
+void SoftwareRenderer::shade_tile(Shading::Fragments& fragments, const uint16_t* pixels, const Tile& tile) {
+    Shading::shade(fragments);
+    for (size_t f = 0; f < fragments.m_count; ++f) {
+        const int p = pixels[f];
+        uint8_t* pixel =
+            tile.m_origin + size_t(p / tile.m_size) * tile.m_stride + size_t(p % tile.m_size) * tile.m_channels;
+        for (int c = 0; c < 3; ++c) {
+            pixel[c] = Shading::unorm8(fragments.m_color[c][f]);
+        }
+    }
+}
+
+bool SoftwareRenderer::read_view(const View& view, int width, int height, int channels, Image& image) {
+    image = Image();
+    image.m_width = width;
+    image.m_height = height;
+    image.m_channels = channels;
+    image.m_pixels.resize(size_t(image.stride()) * image.m_height);
+    return draw(view, image, 0, 0, width, height);
+}
+
+bool SoftwareRenderer::read_atlas(const AtlasLayout& layout, int channels, Image& image) {
+    image = Image();
+    image.m_width = layout.width();
+    image.m_height = layout.height();
+    image.m_channels = channels;
+    image.m_pixels.resize(size_t(image.stride()) * image.m_height);
+    // for the empty tiles
+    clear(image.m_pixels.data(), size_t(image.m_width) * image.m_height, channels);
+    for (size_t v = 0; v < m_views.size(); ++v) {
+        if (draw(m_views[v], image, layout.tile_x(v), layout.tile_y(v), layout.m_tile_width, layout.m_tile_height) ==
+            false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<SoftwareRenderer> make_software_renderer(RendererBackend backend, ThreadPool& pool) {
+    if (backend == RendererBackend::Raycast) {
+        return std::make_unique<RayCaster>(pool);
+    }
+    return std::make_unique<Rasterizer>(pool);
+}
+}  // namespace Graphics
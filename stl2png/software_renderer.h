@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include "image.h"
+#include "model.h"
+#include "options.h"
+#include "renderer.h"
+#include "shading.h"
+#include "thread_pool.h"
+#include "vertex_buffer.h"
+
+namespace Graphics {
+
+// how far the images of -verify and the tests may be from the GL's, channels further apart than the rounding in the
+// shading and the edges, and the share of the pixels that may be
+const int VERIFY_TOLERANCE = 8;
+const double VERIFY_PIXELS = 0.01;
+
+// Draws the views of a model on the CPU over the pool with the shading of vertex.glsl and fragment.glsl, for machines
+// without a GL driver. Images are in glReadPixels order, the bottom row first, cleared like the GL.
+class SoftwareRenderer {
+   public:
+    explicit SoftwareRenderer(ThreadPool& pool) : m_pool(pool) {}
+    virtual ~SoftwareRenderer() = default;
+    SoftwareRenderer(const SoftwareRenderer&) = delete;
+    SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+    // takes the vertices of the model, welded as the options ask
+    virtual bool upload(LoadedModel& model, const RenderOptions& opts) = 0;
+
+    const std::array<View, 7>& views() const { return m_views; }
+
+    // draws the view into a region of an RGB or RGBA image, clearing the region first
+    virtual bool draw(const View& view, Image& image, int x, int y, int width, int height) = 0;
+
+    // draws a view into a new RGB or RGBA image
+    bool read_view(const View& view, int width, int height, int channels, Image& image);
+
+    // draws every view into its tile of a new atlas image, the empty tiles cleared
+    bool read_atlas(const AtlasLayout& layout, int channels, Image& image);
+
+   protected:
+    // the vertices of the model and its views, the vertices of a streamed model loaded whole
+    bool take_vertices(LoadedModel& model, const RenderOptions& opts);
+
+    // fills pixels with the clear colour, opaque
+    static void clear(uint8_t* pixels, size_t count, int channels);
+
+    // A square tile of a region being drawn, its pixels counted from the bottom left of the region, the last ones
+    // included and cut off at the region's edges.
+    struct Tile {
+        int m_size;
+        int m_x0, m_y0, m_x1, m_y1;
+        // the first pixel of the tile in the image, rows counted from the bottom like the GL
+        uint8_t* m_origin;
+        size_t m_stride;
+        int m_channels;
+    };
+
+    // the tile at the index of a region of columns by rows tiles at x, y of the image, cleared
+    static Tile clear_tile(Image& image, int x, int y, int width, int height, size_t tile, int columns, int size);
+
+    // Shades the fragments of a tile and writes their colours, pixels holding the offset of each fragment's pixel from
+    // the first of the tile as row * size + column.
+    static void shade_tile(Shading::Fragments& fragments, const uint16_t* pixels, const Tile& tile);
+
+    // vertex.glsl's vector to the eye of a model space position, M applied from the left, affine in the position so
+    // it interpolates the same
+    static glm::vec3 vert2eye(const View& view, const glm::vec3& position) {
+        return view.m_eyeVec - glm::vec3(glm::vec4(position, 1.f) * view.m_modelMat);
+    }
+
+    // a T per thread, made on first use and reused, for the buffers of a tile too large for the stack
+    template <typename T>
+    static T& thread_buffers() {
+        thread_local std::unique_ptr<T> buffers;
+        if (!buffers) {
+            buffers = std::make_unique<T>();
+        }
+        return *buffers;
+    }
+
+    ThreadPool& m_pool;
+    std::vector<Vert> m_vertices;
+    // three per triangle, or none when the vertices are a triangle soup
+    std::vector<uint32_t> m_indices;
+    std::array<View, 7> m_views;
+};
+
+// the renderer of a software backend
+std::unique_ptr<SoftwareRenderer> make_software_renderer(RendererBackend backend, ThreadPool& pool);
+}  // namespace Graphics
@@ -0,0 +1,159 @@
+#include "stl.h"
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+
+namespace {
+std::streamsize tell_file_size(std::ifstream& fs) {
+    std::streamsize at = fs.tellg();
+    fs.ignore(std::numeric_limits<std::streamsize>::max());
+    std::streamsize sz = fs.gcount();
+    fs.seekg(at);
+    return at + sz;
+}
+}  // namespace
+
+namespace STL {
+std::optional<STLdata> read(const std::string& file) {
+    if (std::ifstream fs = std::ifstream(file, std::ios_base::binary)) {
+        STLdata data;
+        std::streamsize sz = ::tell_file_size(fs);
+
+        // try read header, or as much of it as there is
+        uint8_t head[STL_HEADER_SIZE + 4];
+        const std::streamsize head_size = std::min<std::streamsize>(sz, sizeof(head));
+        fs.read(reinterpret_cast<char*>(head), head_size);
+        if (fs.gcount() != head_size) {
+            std::fputs("Failed reading file...", stderr);
+            return {};
+        }
+
+        switch (detect_format(head, size_t(head_size), uint64_t(sz))) {
+            case Format::ASCII: {
+                std::vector<char> text(static_cast<size_t>(sz));
+                fs.seekg(0);
+                fs.read(text.data(), sz);
+                if (fs.gcount() != sz) {
+                    std::fputs("Failed reading file...", stderr);
+                    return {};
+                }
+                if (parse_ascii(text.data(), text.size(), data) == false) {
+                    return {};
+                }
+                return data;
+            }
+            case Format::Invalid:
+                std::fputs("Invalid STL, neither ASCII nor a binary facet count matching the file size...", stderr);
+                return {};
+            case Format::Binary:
+                break;
+        }
+
+        uint32_t num_facets{0};
+        std::memcpy(&num_facets, head + STL_HEADER_SIZE, 4);
+        data.resize(num_facets);
+
+        constexpr auto read_stl_elem = [](glm::vec3& to, std::ifstream& fs) -> bool {
+            fs.read(reinterpret_cast<char*>(glm::value_ptr(to)), STL_ELEM_SIZE);
+            return fs.gcount() == STL_ELEM_SIZE;
+        };
+        for (auto& face : data) {
+            if (read_stl_elem(face.m_normal, fs) == false) {
+                fputs("Failed reading facet from file...", stderr);
+                return {};
+            }
+            for (auto& v : face.m_vertices) {
+                if (read_stl_elem(v, fs) == false) {
+                    fputs("Failed reading vertex from file...", stderr);
+                    return {};
+                }
+            }
+            fs.read(reinterpret_cast<char*>(&face.m_attribute), 2);
+            if (fs.gcount() != 2) {
+                fputs("Failed reading facet from file...", stderr);
+                return {};
+            }
+        }
+        return data;
+    } else {
+        fprintf(stderr, "Cannot open file, \"%s\"", file.c_str());
+        return {};
+    }
+}
+
+std::optional<MappedSTL> map(const std::string& file) {
+    MappedSTL stl;
+    if (stl.m_file.open(file) == false) {
+        fprintf(stderr, "Cannot map file, \"%s\"\n", file.c_str());
+        return {};
+    }
+    const uint8_t* bytes = stl.m_file.data();
+    const size_t sz = stl.m_file.size();
+    switch (detect_format(bytes, std::min<size_t>(sz, STL_HEADER_SIZE + 4), sz)) {
+        case Format::ASCII:
+            if (parse_ascii(reinterpret_cast<const char*>(bytes), sz, stl.m_parsed) == false) {
+                return {};
+            }
+            // nothing refers to the file anymore
+            stl.m_file.close();
+            stl.m_facets = FacetView(stl.m_parsed.data(), stl.m_parsed.size());
+            return stl;
+        case Format::Invalid:
+            std::fputs("Invalid STL, neither ASCII nor a binary facet count matching the file size...\n", stderr);
+            return {};
+        case Format::Binary:
+            break;
+    }
+
+    uint32_t num_facets{0};
+    std::memcpy(&num_facets, bytes + STL_HEADER_SIZE, 4);
+    stl.m_facets = FacetView(reinterpret_cast<const PackedFacet*>(bytes + STL_HEADER_SIZE + 4), num_facets);
+    return stl;
+}
+
+Format FacetStream::open(const std::string& file) {
+    m_fs = std::ifstream(file, std::ios_base::binary);
+    m_count = m_read = 0;
+    if (!m_fs) {
+        fprintf(stderr, "Cannot open file, \"%s\"\n", file.c_str());
+        return Format::Invalid;
+    }
+    std::streamsize sz = ::tell_file_size(m_fs);
+    uint8_t head[STL_HEADER_SIZE + 4];
+    const std::streamsize head_size = std::min<std::streamsize>(sz, sizeof(head));
+    m_fs.read(reinterpret_cast<char*>(head), head_size);
+    if (m_fs.gcount() != head_size) {
+        std::fputs("Failed reading file...\n", stderr);
+        return Format::Invalid;
+    }
+    Format format = detect_format(head, size_t(head_size), uint64_t(sz));
+    if (format == Format::Binary) {
+        uint32_t num_facets{0};
+        std::memcpy(&num_facets, head + STL_HEADER_SIZE, 4);
+        m_count = num_facets;
+    } else if (format == Format::Invalid) {
+        std::fputs("Invalid STL, neither ASCII nor a binary facet count matching the file size...\n", stderr);
+    }
+    return format;
+}
+
+size_t FacetStream::read(std::vector<PackedFacet>& block, size_t max_facets) {
+    const size_t n = std::min(max_facets, m_count - m_read);
+    block.resize(n);
+    if (n == 0) {
+        return 0;
+    }
+    const std::streamsize bytes = std::streamsize(n) * STL_TRIANGLE_SIZE;
+    m_fs.read(reinterpret_cast<char*>(block.data()), bytes);
+    if (m_fs.gcount() != bytes) {
+        std::fputs("Failed reading facets from file...\n", stderr);
+        block.clear();
+        return 0;
+    }
+    m_read += n;
+    return n;
+}
+}  // namespace STL
@@ -0,0 +1,122 @@
+#pragma once
+#include <stdint.h>
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <glm/vec3.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+namespace STL {
+struct STLfacet {
+    glm::vec3 m_normal;
+    glm::vec3 m_vertices[3];
+    uint16_t m_attribute;
+};
+
+typedef std::vector<STLfacet> STLdata;
+
+const int STL_HEADER_SIZE = 80;
+const int STL_ELEM_SIZE = 3 * 4;
+const int STL_TRIANGLE_SIZE = STL_ELEM_SIZE /*normal*/ + 3 * STL_ELEM_SIZE /*verts*/ + 2 /*attribute*/;
+const int STL_MIN_SIZE = 4 + STL_TRIANGLE_SIZE;
+
+// A binary facet exactly as it is laid out in the file, 50 bytes without padding.
+#pragma pack(push, 1)
+struct PackedFacet {
+    glm::vec3 m_normal;
+    glm::vec3 m_vertices[3];
+    uint16_t m_attribute;
+};
+#pragma pack(pop)
+static_assert(sizeof(PackedFacet) == STL_TRIANGLE_SIZE, "PackedFacet must match the binary STL record");
+
+// Non-owning view of packed facets, at() is bounds-checked and operator[] asserts.
+class FacetView {
+   public:
+    typedef PackedFacet value_type;
+    typedef const PackedFacet* const_iterator;
+
+    FacetView() = default;
+    FacetView(const PackedFacet* facets, size_t count) : m_facets(facets), m_count(count) {}
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    const PackedFacet* begin() const { return m_facets; }
+    const PackedFacet* end() const { return m_facets + m_count; }
+
+    const PackedFacet& operator[](size_t i) const {
+        assert(i < m_count);
+        return m_facets[i];
+    }
+    const PackedFacet& at(size_t i) const {
+        if (i >= m_count) {
+            throw std::out_of_range("STL facet index out of range");
+        }
+        return m_facets[i];
+    }
+    FacetView subview(size_t first, size_t count) const {
+        if (first > m_count || count > m_count - first) {
+            throw std::out_of_range("STL facet range out of range");
+        }
+        return FacetView(m_facets + first, count);
+    }
+
+   private:
+    const PackedFacet* m_facets = nullptr;
+    size_t m_count = 0;
+};
+
+// A binary STL file mapped into memory, the facets are read in place without copying. ASCII files are parsed into
+// packed facets owned by this object so the same view can be used for both.
+class MappedSTL {
+   public:
+    const FacetView& facets() const { return m_facets; }
+
+   private:
+    friend std::optional<MappedSTL> map(const std::string& file);
+    MappedFile m_file;
+    std::vector<PackedFacet> m_parsed;
+    FacetView m_facets;
+};
+
+enum class Format { Binary, ASCII, Invalid };
+
+// Reads the facets of a binary STL file a block at a time, so a file can be loaded without holding all of it in
+// memory.
+class FacetStream {
+   public:
+    // Opens the file and reads the header, returns Binary when ready to stream. ASCII files are detected but can not
+    // be streamed.
+    Format open(const std::string& file);
+
+    // total number of facets in the file
+    size_t size() const { return m_count; }
+
+    // Reads up to max_facets with one read call, returns the number of facets read, 0 at the end or on errors.
+    size_t read(std::vector<PackedFacet>& block, size_t max_facets);
+
+   private:
+    std::ifstream m_fs;
+    size_t m_count = 0;
+    size_t m_read = 0;
+};
+
+// Detects the file format from the first bytes of the file (the 84 byte binary header, or all of a smaller file).
+// A binary file whose facet count matches the file size is binary even if the header starts with "solid".
+Format detect_format(const uint8_t* head, size_t head_size, uint64_t file_size);
+
+// Parses ASCII STL text, appending the facets to out.
+bool parse_ascii(const char* text, size_t size, STLdata& out);
+bool parse_ascii(const char* text, size_t size, std::vector<PackedFacet>& out);
+
+// Reads all facets of a binary or ASCII STL file into memory.
+std::optional<STLdata> read(const std::string& file);
+
+// Memory maps a binary STL file, validating the facet count against the file size. ASCII files are parsed from
+// the mapping.
+std::optional<MappedSTL> map(const std::string& file);
+}  // namespace STL
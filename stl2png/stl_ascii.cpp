@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "stl.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STL_ASCII_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+inline bool is_digit(char c) { return unsigned(c - '0') < 10u; }
+
+#ifdef STL_ASCII_SSE2
+inline unsigned first_bit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// first occurrence of c in [p, end) or end, 16 bytes at a time
+const char* find_byte(const char* p, const char* end, char c) {
+#ifdef STL_ASCII_SSE2
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (mask) {
+            return p + first_bit(mask);
+        }
+    }
+#endif
+    for (; p != end; ++p) {
+        if (*p == c) return p;
+    }
+    return end;
+}
+
+// skips whitespace, long indentation runs are skipped 16 bytes at a time
+const char* skip_space(const char* p, const char* end) {
+    while (p != end && is_space(*p)) {
+#ifdef STL_ASCII_SSE2
+        if (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            // space, or \t \n \v \f \r which are 0x09-0x0d
+            __m128i sp = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+            __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(chunk, _mm_set1_epi8(0x09)), _mm_set1_epi8(4)),
+                                         _mm_sub_epi8(chunk, _mm_set1_epi8(0x09)));
+            unsigned mask = unsigned(_mm_movemask_epi8(_mm_or_si128(sp, ctl)));
+            if (mask == 0xffff) {
+                p += 16;
+                continue;
+            }
+            return p + first_bit(~mask);
+        }
+#endif
+        ++p;
+    }
+    return p;
+}
+
+// matches a whitespace terminated keyword at p
+inline bool match_token(const char* p, const char* end, const char* token, size_t len) {
+    return size_t(end - p) >= len && std::memcmp(p, token, len) == 0 && (p + len == end || is_space(p[len]));
+}
+
+// next whitespace delimited occurrence of a keyword at or after p
+const char* find_token(const char* begin, const char* p, const char* end, const char* token, size_t len) {
+    while ((p = find_byte(p, end, token[0])) != end) {
+        if ((p == begin || is_space(p[-1])) && match_token(p, end, token, len)) {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+const double pow10_table[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parses a decimal float without locale or stream overhead, anything unusual (inf, nan, hex) goes to strtof.
+// Returns nullptr if there is no number at p.
+const char* parse_float(const char* p, const char* end, float& out) {
+    const char* start = p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int exp10 = 0, digits = 0;
+    bool any_digits = false;
+    for (; p != end && is_digit(*p); ++p) {
+        any_digits = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + unsigned(*p - '0');
+            digits += mantissa != 0;
+        } else {
+            ++exp10;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && is_digit(*p); ++p) {
+            any_digits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + unsigned(*p - '0');
+                digits += mantissa != 0;
+                --exp10;
+            }
+        }
+    }
+    if (any_digits && p != end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool exp_negative = false;
+        if (e != end && (*e == '-' || *e == '+')) {
+            exp_negative = *e == '-';
+            ++e;
+        }
+        if (e != end && is_digit(*e)) {
+            int exponent = 0;
+            for (; e != end && is_digit(*e); ++e) {
+                if (exponent < 10000) exponent = exponent * 10 + (*e - '0');
+            }
+            exp10 += exp_negative ? -exponent : exponent;
+            p = e;
+        }
+    }
+    if (!any_digits || (p != end && !is_space(*p))) {
+        char buf[64];
+        size_t len = 0;
+        while (start + len != end && !is_space(start[len]) && len < sizeof(buf) - 1) {
+            buf[len] = start[len];
+            ++len;
+        }
+        buf[len] = '\0';
+        char* parsed_end = nullptr;
+        out = std::strtof(buf, &parsed_end);
+        if (parsed_end == buf || size_t(parsed_end - buf) != len) {
+            return nullptr;
+        }
+        return start + len;
+    }
+    double v = double(mantissa);
+    if (mantissa != 0 && exp10 != 0) {
+        if (exp10 > 0 && exp10 <= 22) {
+            v *= pow10_table[exp10];
+        } else if (exp10 < 0 && exp10 >= -22) {
+            v /= pow10_table[-exp10];
+        } else {
+            v *= std::pow(10.0, exp10);
+        }
+    }
+    out = float(negative ? -v : v);
+    return p;
+}
+
+const char* parse_vec3(const char* p, const char* end, float* v) {
+    for (int i = 0; i < 3; ++i) {
+        p = skip_space(p, end);
+        if ((p = parse_float(p, end, v[i])) == nullptr) {
+            return nullptr;
+        }
+    }
+    return p;
+}
+
+void store_facet(STL::STLfacet& f, const float* r) {
+    f.m_normal = glm::vec3(r[0], r[1], r[2]);
+    for (int i = 0; i < 3; ++i) {
+        f.m_vertices[i] = glm::vec3(r[3 + 3 * i], r[4 + 3 * i], r[5 + 3 * i]);
+    }
+    f.m_attribute = 0;
+}
+
+void store_facet(STL::PackedFacet& f, const float* r) {
+    std::memcpy(static_cast<void*>(&f), r, 12 * sizeof(float));
+    f.m_attribute = 0;
+}
+
+size_t line_of(const char* begin, const char* p) {
+    size_t line = 1;
+    for (const char* it = begin; (it = find_byte(it, p, '\n')) != p; ++it) {
+        ++line;
+    }
+    return line;
+}
+
+template <typename Facet>
+bool parse(const char* text, size_t size, std::vector<Facet>& out) {
+    const char* const begin = text;
+    const char* const end = text + size;
+
+    const char* p = skip_space(begin, end);
+    if (match_token(p, end, "solid", 5) == false) {
+        std::fputs("Not an ASCII STL, missing solid...\n", stderr);
+        return false;
+    }
+    // a typical exporter writes ~250 bytes per facet
+    out.reserve(out.size() + size / 256);
+
+    auto fail = [&](const char* at, const char* what) {
+        fprintf(stderr, "Invalid ASCII STL at line %zu, %s...\n", line_of(begin, at), what);
+        return false;
+    };
+    // skip the rest of the solid line, its name could contain anything
+    p = find_byte(p, end, '\n');
+    float rec[12];
+    while ((p = find_token(begin, p, end, "facet", 5)) != end) {
+        p = skip_space(p + 5, end);
+        if (match_token(p, end, "normal", 6)) {
+            const char* n = parse_vec3(p + 6, end, rec);
+            if (n == nullptr) {
+                return fail(p, "bad facet normal");
+            }
+            p = skip_space(n, end);
+        } else {
+            rec[0] = rec[1] = rec[2] = 0.f;
+        }
+        if (match_token(p, end, "outer", 5)) {
+            p = skip_space(p + 5, end);
+            if (match_token(p, end, "loop", 4) == false) {
+                return fail(p, "expected loop");
+            }
+            p = skip_space(p + 4, end);
+        }
+        for (int i = 0; i < 3; ++i) {
+            if (match_token(p, end, "vertex", 6) == false) {
+                return fail(p, "expected vertex");
+            }
+            const char* v = parse_vec3(p + 6, end, rec + 3 + 3 * i);
+            if (v == nullptr) {
+                return fail(p, "bad vertex");
+            }
+            p = skip_space(v, end);
+        }
+        if (match_token(p, end, "endloop", 7) == false) {
+            return fail(p, "expected endloop");
+        }
+        p = skip_space(p + 7, end);
+        if (match_token(p, end, "endfacet", 8) == false) {
+            return fail(p, "expected endfacet");
+        }
+        p += 8;
+        out.emplace_back();
+        store_facet(out.back(), rec);
+    }
+    if (out.empty()) {
+        std::fputs("ASCII STL without facets...\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+// printable, whitespace or utf-8, binary headers are followed by a facet count that is usually not
+inline bool is_text(uint8_t c) { return c >= 0x20 || is_space(char(c)); }
+}  // namespace
+
+namespace STL {
+Format detect_format(const uint8_t* head, size_t head_size, uint64_t file_size) {
+    const size_t binary_head = STL_HEADER_SIZE + 4;
+    bool binary_fits = false;
+    if (file_size >= binary_head && head_size >= binary_head) {
+        uint32_t num_facets{0};
+        std::memcpy(&num_facets, head + STL_HEADER_SIZE, 4);
+        const uint64_t facets_end = binary_head + uint64_t(num_facets) * STL_TRIANGLE_SIZE;
+        if (num_facets > 0 && facets_end == file_size) {
+            // exact size match, even when the header starts with "solid"
+            return Format::Binary;
+        }
+        binary_fits = num_facets > 0 && facets_end <= file_size;
+    }
+
+    const char* text = reinterpret_cast<const char*>(head);
+    const char* p = skip_space(text, text + head_size);
+    bool text_head = true;
+    for (size_t i = 0; i < head_size && text_head; ++i) {
+        text_head = is_text(head[i]);
+    }
+    if (text_head && match_token(p, text + head_size, "solid", 5)) {
+        return Format::ASCII;
+    }
+    return binary_fits ? Format::Binary : Format::Invalid;
+}
+
+bool parse_ascii(const char* text, size_t size, STLdata& out) { return parse(text, size, out); }
+
+bool parse_ascii(const char* text, size_t size, std::vector<PackedFacet>& out) { return parse(text, size, out); }
+}  // namespace STL
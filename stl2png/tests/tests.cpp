@@ -0,0 +1,151 @@
+// Checks of the software renderers, run by ctest: tests shading and tests software DIR, see CMakeLists.txt.
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include "../image.h"
+#include "../model.h"
+#include "../options.h"
+#include "../shading.h"
+#include "../simd.h"
+#include "../software_renderer.h"
+#include "../thread_pool.h"
+
+namespace {
+// -atlas 64 of reference.ppm, drawn by the GL from torus.stl with the default options and -color rgb
+const int REFERENCE_TILE = 64;
+// FMA and the order of operations of the vector code round differently from the scalar reference
+const int SHADING_TOLERANCE = 1;
+
+// Shades random fragments with each instruction set the CPU has and compares them with the scalar shade(). The count
+// is not a multiple of any vector width so the last partial vector is checked too.
+bool test_shading() {
+    static Shading::Fragments fragments, shaded;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f), distance(0.1f, 10.f);
+    fragments.m_count = Shading::Fragments::CAPACITY - 3;
+    for (size_t i = 0; i < fragments.m_count; ++i) {
+        glm::vec3 normal;
+        do {
+            normal = glm::vec3(unit(random), unit(random), unit(random));
+        } while (glm::dot(normal, normal) < 0.01f);
+        normal = glm::normalize(normal);
+        glm::vec3 eye(unit(random), unit(random), unit(random));
+        eye *= distance(random);
+        for (int c = 0; c < 3; ++c) {
+            fragments.m_normal[c][i] = normal[c];
+            fragments.m_vert2eye[c][i] = eye[c];
+        }
+    }
+
+    bool passed = true;
+    const SIMD::Instructions sets[] = {SIMD::Instructions::None, SIMD::Instructions::SSE2, SIMD::Instructions::AVX2,
+                                       SIMD::Instructions::AVX512};
+    for (SIMD::Instructions set : sets) {
+        if (int(set) > int(SIMD::instructions())) {
+            printf("Shading with %s: skipped, not supported by the CPU\n", SIMD::name(set));
+            continue;
+        }
+        shaded = fragments;
+        Shading::shade(shaded, set);
+        int max = 0;
+        size_t apart = 0;
+        for (size_t i = 0; i < fragments.m_count; ++i) {
+            const glm::vec3 normal(fragments.m_normal[0][i], fragments.m_normal[1][i], fragments.m_normal[2][i]);
+            const glm::vec3 eye(fragments.m_vert2eye[0][i], fragments.m_vert2eye[1][i], fragments.m_vert2eye[2][i]);
+            const glm::vec3 reference = Shading::shade(normal, eye);
+            for (int c = 0; c < 3; ++c) {
+                const int difference = std::abs(int(Shading::unorm8(shaded.m_color[c][i])) -
+                                                int(Shading::unorm8(reference[c])));
+                max = std::max(max, difference);
+                apart += difference > SHADING_TOLERANCE ? 1 : 0;
+            }
+        }
+        printf("Shading with %s: %zu components apart from the scalar code by more than %d, at most %d\n",
+               SIMD::name(set), apart, SHADING_TOLERANCE, max);
+        passed = passed && apart == 0;
+    }
+    return passed;
+}
+
+bool read_ppm(const std::string& path, Graphics::Image& image) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open \"%s\"\n", path.c_str());
+        return false;
+    }
+    image = Graphics::Image();
+    image.m_channels = 3;
+    bool read = fscanf(file, "P6 %d %d 255", &image.m_width, &image.m_height) == 2 && fgetc(file) == '\n' &&
+                image.m_width > 0 && image.m_height > 0;
+    if (read) {
+        image.m_pixels.resize(size_t(image.stride()) * image.m_height);
+        read = fread(image.m_pixels.data(), 1, image.m_pixels.size(), file) == image.m_pixels.size();
+    }
+    fclose(file);
+    if (!read) {
+        fprintf(stderr, "\"%s\" is not a binary PPM\n", path.c_str());
+    }
+    return read;
+}
+
+// Draws the atlas of torus.stl with each software renderer and compares it with the GL's in reference.ppm like
+// -verify does, the rows of both in glReadPixels order.
+bool test_software(const std::string& dir) {
+    Graphics::Image reference;
+    if (read_ppm(dir + "/reference.ppm", reference) == false) {
+        return false;
+    }
+    ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    RenderOptions opts;
+    bool passed = true;
+    const Graphics::RendererBackend backends[] = {Graphics::RendererBackend::Raster,
+                                                  Graphics::RendererBackend::Raycast};
+    for (Graphics::RendererBackend backend : backends) {
+        const char* name = backend == Graphics::RendererBackend::Raster ? "raster" : "raycast";
+        Graphics::LoadedModel model;
+        std::unique_ptr<Graphics::SoftwareRenderer> software = Graphics::make_software_renderer(backend, pool);
+        Graphics::Image image;
+        if (Graphics::load_model(dir + "/torus.stl", opts, pool, model) == false ||
+            software->upload(model, opts) == false ||
+            software->read_atlas(
+                Graphics::make_atlas_layout(software->views().size(), REFERENCE_TILE, REFERENCE_TILE), 3, image) ==
+                false) {
+            fprintf(stderr, "Failed to draw torus.stl with -renderer %s\n", name);
+            passed = false;
+            continue;
+        }
+        Graphics::ImageDifference difference;
+        if (Graphics::compare(image, reference, Graphics::VERIFY_TOLERANCE, difference) == false) {
+            fprintf(stderr, "-renderer %s drew %dx%d, the reference is %dx%d\n", name, image.m_width, image.m_height,
+                    reference.m_width, reference.m_height);
+            passed = false;
+            continue;
+        }
+        const double apart = double(difference.m_pixels) / (double(image.m_width) * image.m_height);
+        printf("-renderer %s: %.3f%% of the pixels apart from the GL by more than %d, at most %d, %.3f on average\n",
+               name, apart * 100.0, Graphics::VERIFY_TOLERANCE, difference.m_max, difference.m_mean);
+        passed = passed && apart <= Graphics::VERIFY_PIXELS;
+    }
+    return passed;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string test = argc > 1 ? argv[1] : "";
+    bool passed = false;
+    if (test == "shading" && argc == 2) {
+        passed = test_shading();
+    } else if (test == "software" && argc == 3) {
+        passed = test_software(argv[2]);
+    } else {
+        fputs("Usage: tests shading | tests software DIR\n", stderr);
+        return 2;
+    }
+    puts(passed ? "Passed" : "Failed");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned threads) : m_size(std::max(threads, 1u)) {
+    if (m_size > 1) {
+        m_threads.reserve(m_size);
+        for (unsigned i = 0; i < m_size; ++i) {
+            m_threads.emplace_back(&ThreadPool::worker, this);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads) {
+        t.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> done = packaged.get_future();
+    if (m_threads.empty()) {
+        packaged();
+        return done;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace(std::move(packaged));
+    }
+    m_wake.notify_one();
+    return done;
+}
+
+unsigned ThreadPool::hardware_threads() { return std::max(std::thread::hardware_concurrency(), 1u); }
+
+void ThreadPool::worker() {
+    for (;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads. A pool of one thread runs all work inline on the calling thread.
+class ThreadPool {
+   public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return m_size; }
+
+    // queues a task, the future reports completion and rethrows exceptions
+    std::future<void> submit(std::function<void()> task);
+
+    // Calls f(first, last) for consecutive ranges of at most chunk items covering [0, count) and waits for all of
+    // them, rethrowing the first exception once all have finished. Must not be called from a task running on this
+    // pool.
+    template <typename F>
+    void parallel_for(size_t count, size_t chunk, F&& f) {
+        chunk = std::max<size_t>(chunk, 1);
+        if (m_size <= 1 || count <= chunk) {
+            for (size_t first = 0; first < count; first += chunk) {
+                f(first, std::min(count, first + chunk));
+            }
+            return;
+        }
+        // the tasks hold f and the caller's frame, so every queued chunk is waited for before an exception leaves
+        std::vector<std::future<void>> done;
+        std::exception_ptr error;
+        try {
+            done.reserve((count + chunk - 1) / chunk);
+            for (size_t first = 0; first < count; first += chunk) {
+                const size_t last = std::min(count, first + chunk);
+                done.emplace_back(submit([&f, first, last]() { f(first, last); }));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& d : done) {
+            try {
+                d.get();
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Calls f(item) for every item in [0, count) with a worker per pool thread. Each worker starts on its own
+    // contiguous share of the items and then steals from the back of the others' shares, so uneven items and
+    // workers held up behind other tasks on the pool do not hold up the rest. Must not be called from a task running
+    // on this pool.
+    template <typename F>
+    void parallel_steal(size_t count, F&& f) {
+        const size_t workers = std::min<size_t>(m_size, count);
+        if (workers <= 1) {
+            for (size_t item = 0; item < count; ++item) {
+                f(item);
+            }
+            return;
+        }
+        // the first item left in the low half of each share and the end in the high half, taken with one CAS
+        std::vector<std::atomic<uint64_t>> shares(workers);
+        for (size_t w = 0; w < workers; ++w) {
+            shares[w] = uint64_t(count * w / workers) | (uint64_t(count * (w + 1) / workers) << 32);
+        }
+        auto take = [&shares](size_t owner, bool front, size_t& item) {
+            uint64_t share = shares[owner].load();
+            for (;;) {
+                const uint64_t first = share & 0xffffffffu, end = share >> 32;
+                if (first >= end) {
+                    return false;
+                }
+                const uint64_t taken = front ? (first + 1) | (end << 32) : first | ((end - 1) << 32);
+                if (shares[owner].compare_exchange_weak(share, taken)) {
+                    item = size_t(front ? first : end - 1);
+                    return true;
+                }
+            }
+        };
+        parallel_for(workers, 1, [&](size_t w, size_t) {
+            size_t item = 0;
+            while (take(w, true, item)) {
+                f(item);
+            }
+            for (size_t victim = (w + 1) % workers; victim != w; victim = (victim + 1) % workers) {
+                while (take(victim, false, item)) {
+                    f(item);
+                }
+            }
+        });
+    }
+
+    // hardware threads, at least one
+    static unsigned hardware_threads();
+
+   private:
+    void worker();
+
+    unsigned m_size = 1;
+    std::vector<std::thread> m_threads;
+    std::queue<std::packaged_task<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
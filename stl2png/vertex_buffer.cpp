@@ -0,0 +1,246 @@
+#include "vertex_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_BUFFER_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+namespace {
+using Graphics::Bounds;
+
+void facet_bounds(const STL::FacetView& facets, size_t first, size_t last, Bounds& bounds) {
+#ifdef VERTEX_BUFFER_SSE2
+    __m128 vmin = _mm_set1_ps(FLT_MAX);
+    __m128 vmax = _mm_set1_ps(-FLT_MAX);
+    __m128d sum_xy = _mm_setzero_pd();
+    __m128d sum_z = _mm_setzero_pd();
+    for (size_t i = first; i < last; ++i) {
+        const char* p = reinterpret_cast<const char*>(facets.begin() + i);
+        // vertices are at byte 12-48, three loads cover them without reading past the facet:
+        // a = x0 y0 z0 x1, b = x1 y1 z1 x2, c = z1 x2 y2 z2 rotated to x2 y2 z2 z1. Lane 3 is ignored.
+        __m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(p + 12));
+        __m128 b = _mm_loadu_ps(reinterpret_cast<const float*>(p + 24));
+        __m128 c = _mm_loadu_ps(reinterpret_cast<const float*>(p + 32));
+        c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 2, 1));
+        vmin = _mm_min_ps(vmin, _mm_min_ps(a, _mm_min_ps(b, c)));
+        vmax = _mm_max_ps(vmax, _mm_max_ps(a, _mm_max_ps(b, c)));
+        __m128 s = _mm_add_ps(_mm_add_ps(a, b), c);
+        sum_xy = _mm_add_pd(sum_xy, _mm_cvtps_pd(s));
+        sum_z = _mm_add_pd(sum_z, _mm_cvtps_pd(_mm_movehl_ps(s, s)));
+    }
+    float mn[4], mx[4];
+    double xy[2], z[2];
+    _mm_storeu_ps(mn, vmin);
+    _mm_storeu_ps(mx, vmax);
+    _mm_storeu_pd(xy, sum_xy);
+    _mm_storeu_pd(z, sum_z);
+    bounds.m_min = glm::vec3(mn[0], mn[1], mn[2]);
+    bounds.m_max = glm::vec3(mx[0], mx[1], mx[2]);
+    bounds.m_sum[0] = xy[0];
+    bounds.m_sum[1] = xy[1];
+    bounds.m_sum[2] = z[0];
+    bounds.m_count = 3 * uint64_t(last - first);
+#else
+    for (size_t i = first; i < last; ++i) {
+        const auto& f = facets[i];
+        for (int k = 0; k < 3; ++k) {
+            const glm::vec3 v = f.m_vertices[k];
+            bounds.add(v);
+        }
+    }
+#endif
+}
+
+#ifdef VERTEX_BUFFER_SSE2
+bool cpu_has_avx() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // AVX and OSXSAVE, then check the OS saves the YMM registers
+    if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 27)) == 0) {
+        return false;
+    }
+    return (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+// Loads 4 packed facets transposed to SoA rows nx ny nz x0 y0 z0 x1 y1 z1 x2 y2 z2, the loads are at byte 0, 16
+// and 32 of each facet so nothing past the 48 float bytes is read.
+inline void load_soa4(const char* p, __m128 rows[12]) {
+    for (int part = 0; part < 3; ++part) {
+        __m128 r0 = _mm_loadu_ps(reinterpret_cast<const float*>(p + 0 * STL::STL_TRIANGLE_SIZE + 16 * part));
+        __m128 r1 = _mm_loadu_ps(reinterpret_cast<const float*>(p + 1 * STL::STL_TRIANGLE_SIZE + 16 * part));
+        __m128 r2 = _mm_loadu_ps(reinterpret_cast<const float*>(p + 2 * STL::STL_TRIANGLE_SIZE + 16 * part));
+        __m128 r3 = _mm_loadu_ps(reinterpret_cast<const float*>(p + 3 * STL::STL_TRIANGLE_SIZE + 16 * part));
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        rows[4 * part + 0] = r0;
+        rows[4 * part + 1] = r1;
+        rows[4 * part + 2] = r2;
+        rows[4 * part + 3] = r3;
+    }
+}
+
+// interleaves SoA rows of W facets to 3 * W vertices
+template <int W>
+inline void store_vertices(const float (&soa)[12][W], Graphics::Vert* out) {
+    for (int f = 0; f < W; ++f) {
+        for (int k = 0; k < 3; ++k) {
+            Graphics::Vert& v = out[3 * f + k];
+            v.x = soa[3 + 3 * k][f];
+            v.y = soa[4 + 3 * k][f];
+            v.z = soa[5 + 3 * k][f];
+            v.nx = soa[0][f];
+            v.ny = soa[1][f];
+            v.nz = soa[2][f];
+        }
+    }
+}
+
+// The normal math mirrors the scalar glm code operation for operation: length(n) < 1e-5 picks
+// cross(v1 - v0, v2 - v0) instead, then n * (1 / sqrt(dot(n, n))).
+void convert4_sse(const char* p, Graphics::Vert* out) {
+    __m128 r[12];
+    load_soa4(p, r);
+    const __m128 e1x = _mm_sub_ps(r[6], r[3]), e1y = _mm_sub_ps(r[7], r[4]), e1z = _mm_sub_ps(r[8], r[5]);
+    const __m128 e2x = _mm_sub_ps(r[9], r[3]), e2y = _mm_sub_ps(r[10], r[4]), e2z = _mm_sub_ps(r[11], r[5]);
+    const __m128 cx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e2y, e1z));
+    const __m128 cy = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e2z, e1x));
+    const __m128 cz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e2x, e1y));
+    auto dot = [](__m128 x, __m128 y, __m128 z) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    };
+    const __m128 degenerate = _mm_cmplt_ps(_mm_sqrt_ps(dot(r[0], r[1], r[2])), _mm_set1_ps(1e-5f));
+    auto select = [degenerate](__m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(degenerate, a), _mm_andnot_ps(degenerate, b));
+    };
+    const __m128 nx = select(cx, r[0]), ny = select(cy, r[1]), nz = select(cz, r[2]);
+    const __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(dot(nx, ny, nz)));
+    r[0] = _mm_mul_ps(nx, inv);
+    r[1] = _mm_mul_ps(ny, inv);
+    r[2] = _mm_mul_ps(nz, inv);
+    float soa[12][4];
+    for (int i = 0; i < 12; ++i) {
+        _mm_storeu_ps(soa[i], r[i]);
+    }
+    store_vertices(soa, out);
+}
+
+TARGET_AVX void convert8_avx(const char* p, Graphics::Vert* out) {
+    __m128 lo[12], hi[12];
+    load_soa4(p, lo);
+    load_soa4(p + 4 * STL::STL_TRIANGLE_SIZE, hi);
+    __m256 r[12];
+    for (int i = 0; i < 12; ++i) {
+        r[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[i]), hi[i], 1);
+    }
+    const __m256 e1x = _mm256_sub_ps(r[6], r[3]), e1y = _mm256_sub_ps(r[7], r[4]), e1z = _mm256_sub_ps(r[8], r[5]);
+    const __m256 e2x = _mm256_sub_ps(r[9], r[3]), e2y = _mm256_sub_ps(r[10], r[4]), e2z = _mm256_sub_ps(r[11], r[5]);
+    const __m256 cx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e2y, e1z));
+    const __m256 cy = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e2z, e1x));
+    const __m256 cz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e2x, e1y));
+    const __m256 n2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], r[0]), _mm256_mul_ps(r[1], r[1])),
+                                    _mm256_mul_ps(r[2], r[2]));
+    const __m256 degenerate = _mm256_cmp_ps(_mm256_sqrt_ps(n2), _mm256_set1_ps(1e-5f), _CMP_LT_OQ);
+    const __m256 nx = _mm256_blendv_ps(r[0], cx, degenerate);
+    const __m256 ny = _mm256_blendv_ps(r[1], cy, degenerate);
+    const __m256 nz = _mm256_blendv_ps(r[2], cz, degenerate);
+    const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)),
+                                    _mm256_mul_ps(nz, nz));
+    const __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(d2));
+    r[0] = _mm256_mul_ps(nx, inv);
+    r[1] = _mm256_mul_ps(ny, inv);
+    r[2] = _mm256_mul_ps(nz, inv);
+    float soa[12][8];
+    for (int i = 0; i < 12; ++i) {
+        _mm256_storeu_ps(soa[i], r[i]);
+    }
+    _mm256_zeroupper();
+    store_vertices(soa, out);
+}
+#endif
+}  // namespace
+
+namespace {
+// range quantised to, an empty axis quantises to 0 and keeps a unit scale
+glm::vec3 quantization_extent(const glm::vec3& vmin, const glm::vec3& vmax) {
+    glm::vec3 extent = vmax - vmin;
+    for (int i = 0; i < 3; ++i) {
+        if (!(extent[i] > 0.f)) extent[i] = 1.f;
+    }
+    return extent;
+}
+
+inline uint32_t snorm10(float f) {
+    const float c = std::min(std::max(f, -1.f), 1.f);
+    return static_cast<uint32_t>(static_cast<int32_t>(std::lround(c * 511.f))) & 0x3ffu;
+}
+
+inline uint16_t unorm16(float f) {
+    return static_cast<uint16_t>(std::lround(std::min(std::max(f, 0.f), 1.f) * 65535.f));
+}
+}  // namespace
+
+namespace Graphics {
+void quantize_vertices(const std::vector<Vert>& vertices, const glm::vec3& vmin, const glm::vec3& vmax,
+                       std::vector<CompactVert>& out, ThreadPool& pool) {
+    const glm::vec3 extent = quantization_extent(vmin, vmax);
+    const glm::vec3 inv_extent(1.f / extent.x, 1.f / extent.y, 1.f / extent.z);
+    out.resize(vertices.size());
+    pool.parallel_for(vertices.size(), 3 * FILL_CHUNK_FACETS, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const Vert& v = vertices[i];
+            CompactVert& c = out[i];
+            c.x = unorm16((v.x - vmin.x) * inv_extent.x);
+            c.y = unorm16((v.y - vmin.y) * inv_extent.y);
+            c.z = unorm16((v.z - vmin.z) * inv_extent.z);
+            c.pad = 0;
+            c.normal = snorm10(v.nx) | (snorm10(v.ny) << 10) | (snorm10(v.nz) << 20);
+        }
+    });
+}
+
+glm::mat4 dequantization_matrix(const glm::vec3& vmin, const glm::vec3& vmax) {
+    return glm::scale(glm::translate(glm::mat4(1.f), vmin), quantization_extent(vmin, vmax));
+}
+
+void fill_vertices(const STL::FacetView& facets, size_t first, size_t last, Vert* out, Bounds* bounds) {
+    size_t i = first;
+#ifdef VERTEX_BUFFER_SSE2
+    static const bool avx = cpu_has_avx();
+    const char* base = reinterpret_cast<const char*>(facets.begin());
+    if (avx) {
+        for (; i + 8 <= last; i += 8) {
+            convert8_avx(base + i * STL::STL_TRIANGLE_SIZE, out + 3 * i);
+        }
+    }
+    for (; i + 4 <= last; i += 4) {
+        convert4_sse(base + i * STL::STL_TRIANGLE_SIZE, out + 3 * i);
+    }
+#endif
+    fill_vertices<STL::FacetView>(facets, i, last, out, nullptr);
+    if (bounds) {
+        Bounds chunk;
+        facet_bounds(facets, first, last, chunk);
+        bounds->merge(chunk);
+    }
+}
+
+Bounds compute_bounds(const STL::FacetView& facets, ThreadPool& pool) {
+    std::vector<Bounds> partials((facets.size() + FILL_CHUNK_FACETS - 1) / FILL_CHUNK_FACETS);
+    pool.parallel_for(facets.size(), FILL_CHUNK_FACETS, [&](size_t first, size_t last) {
+        facet_bounds(facets, first, last, partials[first / FILL_CHUNK_FACETS]);
+    });
+    return reduce_bounds(std::move(partials));
+}
+}  // namespace Graphics
@@ -0,0 +1,175 @@
+#pragma once
+#include <glad/glad.h>
+#include <stdint.h>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <vector>
+#include "stl.h"
+#include "thread_pool.h"
+
+namespace Graphics {
+
+#pragma pack(push, 1)
+struct Vert {
+    // left uninitialized so vertex buffers can be sized up front and filled in place
+    Vert() {}
+    Vert(const glm::vec3& pos, const glm::vec3& normal)
+        : x(pos[0]), y(pos[1]), z(pos[2]), nx(normal[0]), ny(normal[1]), nz(normal[2]) {}
+    float x, y, z;
+    float nx, ny, nz;
+    static const int position_offset = 0;
+    static const int position_elements = 3;
+    static const int position_type = GL_FLOAT;
+    static const int position_normalized = GL_FALSE;
+    static const int normal_offset = 3 * sizeof(float);
+    static const int normal_elements = 3;
+    static const int normal_type = GL_FLOAT;
+    static const int normal_normalized = GL_FALSE;
+};
+
+// Compact 12 byte vertex, half the size of Vert. The position is quantised to 16 bits per axis over the model bounds
+// (see dequantization_matrix) and the normal is a signed normalized 10_10_10_2 vector.
+struct CompactVert {
+    uint16_t x, y, z, pad;
+    uint32_t normal;
+    static const int position_offset = 0;
+    static const int position_elements = 3;
+    static const int position_type = GL_UNSIGNED_SHORT;
+    static const int position_normalized = GL_TRUE;
+    static const int normal_offset = 4 * sizeof(uint16_t);
+    static const int normal_elements = 4;
+    static const int normal_type = GL_INT_2_10_10_10_REV;
+    static const int normal_normalized = GL_TRUE;
+};
+#pragma pack(pop)
+
+// Points the vertex attributes at the bound GL_ARRAY_BUFFER laid out as V.
+template <typename V>
+void set_vertex_attributes(GLint position_location, GLint normal_location) {
+    glEnableVertexAttribArray(position_location);
+    glVertexAttribPointer(position_location, V::position_elements, V::position_type, V::position_normalized,
+                          sizeof(V), reinterpret_cast<void*>(V::position_offset));
+    if (normal_location >= 0) {
+        glEnableVertexAttribArray(normal_location);
+        glVertexAttribPointer(normal_location, V::normal_elements, V::normal_type, V::normal_normalized, sizeof(V),
+                              reinterpret_cast<const void*>(int(V::normal_offset)));
+    }
+}
+
+// Min/max and coordinate sum of a set of vertices, partial results of chunks are combined with merge.
+struct Bounds {
+    glm::vec3 m_min = glm::vec3(FLT_MAX);
+    glm::vec3 m_max = glm::vec3(-FLT_MAX);
+    double m_sum[3] = {0.0, 0.0, 0.0};
+    uint64_t m_count = 0;
+
+    void add(const glm::vec3& v) {
+        m_min = glm::min(m_min, v);
+        m_max = glm::max(m_max, v);
+        m_sum[0] += v.x;
+        m_sum[1] += v.y;
+        m_sum[2] += v.z;
+        ++m_count;
+    }
+    void merge(const Bounds& other) {
+        m_min = glm::min(m_min, other.m_min);
+        m_max = glm::max(m_max, other.m_max);
+        for (int i = 0; i < 3; ++i) {
+            m_sum[i] += other.m_sum[i];
+        }
+        m_count += other.m_count;
+    }
+    glm::vec3 centroid() const {
+        if (m_count == 0) {
+            return glm::vec3(0.f);
+        }
+        return glm::vec3(float(m_sum[0] / m_count), float(m_sum[1] / m_count), float(m_sum[2] / m_count));
+    }
+};
+
+// Merges chunk partials pairwise, keeping the rounding error of the coordinate sums low for huge meshes.
+inline Bounds reduce_bounds(std::vector<Bounds> partials) {
+    if (partials.empty()) {
+        return Bounds();
+    }
+    for (size_t step = 1; step < partials.size(); step *= 2) {
+        for (size_t i = 0; i + step < partials.size(); i += 2 * step) {
+            partials[i].merge(partials[i + step]);
+        }
+    }
+    return partials.front();
+}
+
+// facets per task when filling vertex buffers in parallel
+const size_t FILL_CHUNK_FACETS = 64 * 1024;
+
+// Bounds and centroid of the facet vertices without converting them, a SIMD pass over the packed facets split in
+// chunks over the pool. Fast enough to run ahead of the vertex conversion so the model matrix and GPU buffer can be
+// set up while vertices are still being built.
+Bounds compute_bounds(const STL::FacetView& facets, ThreadPool& pool);
+
+// Converts facets [first, last) to vertices at out[3 * first], recomputing missing normals. Bounds are optional.
+template <typename Facets>
+void fill_vertices(const Facets& data, size_t first, size_t last, Vert* out, Bounds* bounds) {
+    using namespace glm;
+    for (size_t i = first; i < last; ++i) {
+        const auto& f = data[i];
+        // copy out of the facet, packed facets can not be bound by reference
+        const vec3 verts[3] = {f.m_vertices[0], f.m_vertices[1], f.m_vertices[2]};
+        vec3 fn = f.m_normal;
+        if (length(fn) < 1e-5f) {
+            fn = normalize(cross(verts[1] - verts[0], verts[2] - verts[0]));
+        } else {
+            fn = normalize(fn);
+        }
+        Vert* dst = out + 3 * i;
+        for (auto& v : verts) {
+            *dst++ = Vert(v, fn);
+        }
+        if (bounds) {
+            for (auto& v : verts) {
+                bounds->add(v);
+            }
+        }
+    }
+}
+
+// Quantises vertices to CompactVert over the bounds [vmin, vmax], split in chunks over the pool.
+void quantize_vertices(const std::vector<Vert>& vertices, const glm::vec3& vmin, const glm::vec3& vmax,
+                       std::vector<CompactVert>& out, ThreadPool& pool);
+
+// Maps the normalized [0, 1] positions of quantised vertices back to model space. Fold it into the model matrix, as
+// model * dequant for positions, and transpose(dequant) * model for the "M" uniform of vertex.glsl which is applied
+// from the left.
+glm::mat4 dequantization_matrix(const glm::vec3& vmin, const glm::vec3& vmax);
+
+// Vectorised conversion of packed facets, 8 at a time with AVX or 4 with SSE2 as the CPU allows and the scalar code
+// above for the remainder and other CPUs. Produces exactly the same vertices as the scalar code.
+void fill_vertices(const STL::FacetView& facets, size_t first, size_t last, Vert* out, Bounds* bounds);
+
+// Converts all facets to vertices at out, split in chunks over the pool. If bounds are wanted each chunk keeps its
+// own which are reduced in chunk order at the end, so the result does not depend on the number of threads.
+template <typename Facets>
+void fill_vertex_range(const Facets& data, Vert* out, ThreadPool& pool, Bounds* bounds = nullptr) {
+    const size_t count = data.size();
+    std::vector<Bounds> partials(bounds ? (count + FILL_CHUNK_FACETS - 1) / FILL_CHUNK_FACETS : 0);
+    pool.parallel_for(count, FILL_CHUNK_FACETS, [&](size_t first, size_t last) {
+        fill_vertices(data, first, last, out, bounds ? &partials[first / FILL_CHUNK_FACETS] : nullptr);
+    });
+    if (bounds) {
+        *bounds = reduce_bounds(std::move(partials));
+    }
+}
+
+// Builds the vertex buffer of all facets.
+template <typename Facets>
+void fill_vertex_buffer(const Facets& data, std::vector<Vert>& vertices, glm::vec3& vmin, glm::vec3& vmax,
+                        glm::vec3& centroid, ThreadPool& pool) {
+    vertices.resize(data.size() * 3);
+    Bounds bounds;
+    fill_vertex_range(data, vertices.data(), pool, &bounds);
+    vmin = bounds.m_min;
+    vmax = bounds.m_max;
+    centroid = bounds.centroid();
+}
+}  // namespace Graphics
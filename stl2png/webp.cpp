@@ -0,0 +1,456 @@
+#include "webp.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "huffman.h"
+
+namespace WebP {
+
+namespace {
+using Huffman::BitWriter;
+
+const uint8_t SIGNATURE = 0x2f;
+const int LENGTH_CODES = 24;
+// literal green values and the length prefix codes, there is no color cache
+const int GREEN_SYMBOLS = 256 + LENGTH_CODES;
+const int DISTANCE_CODES = 40;
+const int CODE_LENGTHS = 19;
+const unsigned MAX_CODE_LENGTH_LENGTH = 7;
+// order the code length code lengths are written in
+const uint8_t CODE_LENGTH_ORDER[CODE_LENGTHS] = {17, 18, 0, 1, 2, 3, 4, 5, 16, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+// distance codes up to 120 stand for pixels near the current one, 1 the one above and 2 the one to the left
+const uint32_t PLANE_CODES = 120;
+// linear distances follow, up to the largest distance code value
+const uint32_t MAX_DISTANCE = (1u << 20) - PLANE_CODES;
+const unsigned MIN_LENGTH = 3;
+const unsigned MAX_LENGTH = 4096;
+const unsigned HASH_BITS = 16;
+
+enum Transform { PREDICTOR = 0, SUBTRACT_GREEN = 2 };
+// 32x32 pixel blocks share a predictor
+const unsigned PREDICTOR_BITS = 5;
+enum Predictor { LEFT = 1, TOP = 2, SELECT = 11, GRADIENT = 12 };
+
+// a literal ARGB pixel when the distance is 0, otherwise a backward reference
+struct Token {
+    uint32_t m_value;
+    uint32_t m_distance;
+};
+
+// the prefix code of a length or distance value and the extra bits following it
+struct Prefix {
+    uint32_t m_code;
+    unsigned m_extra_bits;
+    uint32_t m_extra;
+};
+
+Prefix prefix(uint32_t value) {
+    const uint32_t v = value - 1;
+    if (v < 4) {
+        return {v, 0, 0};
+    }
+    unsigned high = 2;
+    while (v >> (high + 1)) {
+        ++high;
+    }
+    const unsigned extra_bits = high - 1;
+    return {2 * high + ((v >> extra_bits) & 1), extra_bits, v & ((1u << extra_bits) - 1)};
+}
+
+inline int channel(uint32_t argb, unsigned shift) { return (argb >> shift) & 0xff; }
+
+// per channel a - b, modulo 256
+inline uint32_t subtract_pixels(uint32_t a, uint32_t b) {
+    const uint32_t alpha_green = 0x00ff00ffu + (a & 0xff00ff00u) - (b & 0xff00ff00u);
+    const uint32_t red_blue = 0xff00ff00u + (a & 0x00ff00ffu) - (b & 0x00ff00ffu);
+    return (alpha_green & 0xff00ff00u) | (red_blue & 0x00ff00ffu);
+}
+
+template <Predictor MODE>
+inline uint32_t predict(uint32_t left, uint32_t top, uint32_t top_left) {
+    if (MODE == LEFT) {
+        return left;
+    }
+    if (MODE == TOP) {
+        return top;
+    }
+    if (MODE == SELECT) {
+        // whichever of left and top is closer to the gradient estimate left + top - top left
+        int difference = 0;
+        for (unsigned shift = 0; shift < 32; shift += 8) {
+            difference += std::abs(channel(left, shift) - channel(top_left, shift)) -
+                          std::abs(channel(top, shift) - channel(top_left, shift));
+        }
+        return difference <= 0 ? top : left;
+    }
+    uint32_t p = 0;
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        const int c = channel(left, shift) + channel(top, shift) - channel(top_left, shift);
+        p |= uint32_t(std::min(std::max(c, 0), 255)) << shift;
+    }
+    return p;
+}
+
+uint32_t predict(Predictor mode, uint32_t left, uint32_t top, uint32_t top_left) {
+    switch (mode) {
+        case LEFT:
+            return predict<LEFT>(left, top, top_left);
+        case TOP:
+            return predict<TOP>(left, top, top_left);
+        case SELECT:
+            return predict<SELECT>(left, top, top_left);
+        case GRADIENT:
+            return predict<GRADIENT>(left, top, top_left);
+    }
+    return left;
+}
+
+// the size of a residual, treating channels as signed
+inline unsigned residual_cost(uint32_t residual) {
+    unsigned cost = 0;
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        cost += std::abs(int(int8_t(residual >> shift)));
+    }
+    return cost;
+}
+
+// the residual cost of predicting the pixels of a block with the mode, skipping the first row and column
+template <Predictor MODE>
+unsigned block_cost(const uint32_t* argb, int width, int x0, int y0, int x1, int y1) {
+    unsigned cost = 0;
+    for (int y = std::max(y0, 1); y < y1; ++y) {
+        const uint32_t* row = argb + size_t(y) * width;
+        const uint32_t* above = row - width;
+        for (int x = std::max(x0, 1); x < x1; ++x) {
+            cost += residual_cost(subtract_pixels(row[x], predict<MODE>(row[x - 1], above[x], above[x - 1])));
+        }
+    }
+    return cost;
+}
+
+// Picks the predictor of each block with the smallest residuals and replaces the pixels by their residuals, returns
+// the predictor image.
+std::vector<uint32_t> apply_predictors(std::vector<uint32_t>& argb, int width, int height) {
+    const int block = 1 << PREDICTOR_BITS;
+    const int blocks_x = (width + block - 1) >> PREDICTOR_BITS;
+    const int blocks_y = (height + block - 1) >> PREDICTOR_BITS;
+    std::vector<uint32_t> modes(size_t(blocks_x) * blocks_y);
+    for (int by = 0; by < blocks_y; ++by) {
+        for (int bx = 0; bx < blocks_x; ++bx) {
+            const int x0 = bx * block, x1 = std::min(x0 + block, width);
+            const int y0 = by * block, y1 = std::min(y0 + block, height);
+            // flat blocks, as most of the background, stop at the first predictor leaving nothing
+            Predictor best = LEFT;
+            unsigned best_cost = block_cost<LEFT>(argb.data(), width, x0, y0, x1, y1);
+            auto consider = [&](Predictor mode, unsigned cost) {
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best = mode;
+                }
+            };
+            if (best_cost > 0) {
+                consider(TOP, block_cost<TOP>(argb.data(), width, x0, y0, x1, y1));
+            }
+            if (best_cost > 0) {
+                consider(SELECT, block_cost<SELECT>(argb.data(), width, x0, y0, x1, y1));
+            }
+            if (best_cost > 0) {
+                consider(GRADIENT, block_cost<GRADIENT>(argb.data(), width, x0, y0, x1, y1));
+            }
+            // the mode is in the green channel
+            modes[size_t(by) * blocks_x + bx] = uint32_t(best) << 8;
+        }
+    }
+
+    // bottom up so the neighbours are still the original pixels; the first row predicts from the left, the first
+    // column from the top and the first pixel from opaque black
+    for (int y = height; y-- > 0;) {
+        uint32_t* row = argb.data() + size_t(y) * width;
+        const uint32_t* above = row - width;
+        const uint32_t* block_modes = modes.data() + size_t(y >> PREDICTOR_BITS) * blocks_x;
+        for (int x = width; x-- > 0;) {
+            uint32_t prediction;
+            if (y == 0) {
+                prediction = x == 0 ? 0xff000000u : row[x - 1];
+            } else if (x == 0) {
+                prediction = above[0];
+            } else {
+                const Predictor mode = Predictor((block_modes[x >> PREDICTOR_BITS] >> 8) & 0xf);
+                prediction = predict(mode, row[x - 1], above[x], above[x - 1]);
+            }
+            row[x] = subtract_pixels(row[x], prediction);
+        }
+    }
+    return modes;
+}
+
+// LZ77 over the pixels, trying the pixels to the left and above and the last one with the same hash
+std::vector<Token> find_matches(const std::vector<uint32_t>& argb, int width) {
+    const size_t count = argb.size();
+    std::vector<Token> tokens;
+    tokens.reserve(count / 4);
+    std::vector<uint32_t> head(size_t(1) << HASH_BITS, ~0u);
+    auto hash = [&](size_t i) { return ((argb[i] ^ (argb[i + 1] * 0x9e3779b1u)) * 2654435761u) >> (32 - HASH_BITS); };
+    for (size_t i = 0; i < count;) {
+        const unsigned limit = unsigned(std::min<size_t>(MAX_LENGTH, count - i));
+        size_t best_length = 0, best_distance = 0;
+        auto try_match = [&](size_t distance) {
+            if (distance == 0 || distance > i || distance > MAX_DISTANCE) {
+                return;
+            }
+            const uint32_t* a = argb.data() + i;
+            const uint32_t* b = a - distance;
+            unsigned length = 0;
+            while (length < limit && a[length] == b[length]) {
+                ++length;
+            }
+            if (length > best_length) {
+                best_length = length;
+                best_distance = distance;
+            }
+        };
+        try_match(1);
+        try_match(width);
+        if (i + 1 < count) {
+            const uint32_t h = hash(i);
+            if (head[h] != ~0u) {
+                try_match(i - head[h]);
+            }
+            head[h] = uint32_t(i);
+        }
+        if (best_length >= MIN_LENGTH) {
+            const uint32_t code = best_distance == size_t(width) ? 1
+                                  : best_distance == 1           ? 2
+                                                                 : uint32_t(best_distance) + PLANE_CODES;
+            tokens.push_back({uint32_t(best_length), code});
+            for (size_t j = i + 1; j < i + best_length && j + 1 < count; ++j) {
+                head[hash(j)] = uint32_t(j);
+            }
+            i += best_length;
+        } else {
+            tokens.push_back({argb[i], 0});
+            ++i;
+        }
+    }
+    return tokens;
+}
+
+// Writes a prefix code for the frequencies and fills in the code and length of each symbol. Up to two symbols
+// below 256 fit the short form, a single symbol takes no bits at all.
+void write_code(const uint32_t* freq, int count, BitWriter& writer, uint8_t* lengths, uint16_t* codes) {
+    std::fill(lengths, lengths + count, uint8_t(0));
+    std::fill(codes, codes + count, uint16_t(0));
+    int used[3];
+    int used_count = 0;
+    for (int i = 0; i < count && used_count < 3; ++i) {
+        if (freq[i]) {
+            used[used_count++] = i;
+        }
+    }
+    if (used_count <= 2 && (used_count == 0 || used[used_count - 1] < 256)) {
+        if (used_count == 0) {
+            used[used_count++] = 0;
+        }
+        writer.put(1, 1);
+        writer.put(used_count - 1, 1);
+        if (used[0] < 2) {
+            writer.put(0, 1);
+            writer.put(used[0], 1);
+        } else {
+            writer.put(1, 1);
+            writer.put(used[0], 8);
+        }
+        if (used_count == 2) {
+            writer.put(used[1], 8);
+            lengths[used[0]] = lengths[used[1]] = 1;
+            Huffman::canonical_codes(lengths, count, codes);
+        }
+        return;
+    }
+
+    Huffman::huffman_lengths(freq, count, Huffman::MAX_CODE_LENGTH, lengths);
+    // Run length code the lengths, 16 repeats the previous length 3-6 times, 17 and 18 are runs of 3-10 and 11-138
+    // zeros
+    struct RunSymbol {
+        uint8_t m_symbol;
+        uint8_t m_extra;
+    };
+    std::vector<RunSymbol> runs;
+    for (int i = 0; i < count;) {
+        const uint8_t length = lengths[i];
+        int run = 1;
+        while (i + run < count && lengths[i + run] == length) {
+            ++run;
+        }
+        i += run;
+        if (length == 0) {
+            while (run >= 11) {
+                const int n = std::min(run, 138);
+                runs.push_back({18, uint8_t(n - 11)});
+                run -= n;
+            }
+            if (run >= 3) {
+                runs.push_back({17, uint8_t(run - 3)});
+                run = 0;
+            }
+        } else {
+            runs.push_back({length, 0});
+            --run;
+            while (run >= 3) {
+                const int n = std::min(run, 6);
+                runs.push_back({16, uint8_t(n - 3)});
+                run -= n;
+            }
+        }
+        for (; run > 0; --run) {
+            runs.push_back({length, 0});
+        }
+    }
+    uint32_t code_length_freq[CODE_LENGTHS] = {0};
+    for (const auto& r : runs) {
+        ++code_length_freq[r.m_symbol];
+    }
+    uint8_t code_length_lengths[CODE_LENGTHS];
+    uint16_t code_length_codes[CODE_LENGTHS];
+    Huffman::huffman_lengths(code_length_freq, CODE_LENGTHS, MAX_CODE_LENGTH_LENGTH, code_length_lengths);
+    Huffman::canonical_codes(code_length_lengths, CODE_LENGTHS, code_length_codes);
+    int code_length_count = CODE_LENGTHS;
+    while (code_length_count > 4 && code_length_lengths[CODE_LENGTH_ORDER[code_length_count - 1]] == 0) {
+        --code_length_count;
+    }
+
+    writer.put(0, 1);
+    writer.put(code_length_count - 4, 4);
+    for (int i = 0; i < code_length_count; ++i) {
+        writer.put(code_length_lengths[CODE_LENGTH_ORDER[i]], 3);
+    }
+    // the lengths of the whole alphabet follow
+    writer.put(0, 1);
+    const bool single_length = std::count_if(code_length_freq, code_length_freq + CODE_LENGTHS,
+                                             [](uint32_t f) { return f != 0; }) == 1;
+    static const unsigned RUN_EXTRA_BITS[3] = {2, 3, 7};
+    for (const auto& r : runs) {
+        if (!single_length) {
+            writer.put(code_length_codes[r.m_symbol], code_length_lengths[r.m_symbol]);
+        }
+        if (r.m_symbol >= 16) {
+            writer.put(r.m_extra, RUN_EXTRA_BITS[r.m_symbol - 16]);
+        }
+    }
+
+    Huffman::canonical_codes(lengths, count, codes);
+    if (used_count == 1) {
+        lengths[used[0]] = 0;
+    }
+}
+
+// Writes an entropy coded image, the main image also says it has a single set of prefix codes.
+void write_image(const std::vector<uint32_t>& argb, int width, bool main_image, BitWriter& writer) {
+    const std::vector<Token> tokens = find_matches(argb, width);
+    std::vector<uint32_t> green(GREEN_SYMBOLS, 0), red(256, 0), blue(256, 0), alpha(256, 0);
+    std::vector<uint32_t> distance(DISTANCE_CODES, 0);
+    for (const Token& t : tokens) {
+        if (t.m_distance) {
+            ++green[256 + prefix(t.m_value).m_code];
+            ++distance[prefix(t.m_distance).m_code];
+        } else {
+            ++green[channel(t.m_value, 8)];
+            ++red[channel(t.m_value, 16)];
+            ++blue[channel(t.m_value, 0)];
+            ++alpha[channel(t.m_value, 24)];
+        }
+    }
+
+    // no color cache
+    writer.put(0, 1);
+    if (main_image) {
+        writer.put(0, 1);
+    }
+    uint8_t green_lengths[GREEN_SYMBOLS], red_lengths[256], blue_lengths[256], alpha_lengths[256],
+        distance_lengths[DISTANCE_CODES];
+    uint16_t green_codes[GREEN_SYMBOLS], red_codes[256], blue_codes[256], alpha_codes[256],
+        distance_codes[DISTANCE_CODES];
+    write_code(green.data(), GREEN_SYMBOLS, writer, green_lengths, green_codes);
+    write_code(red.data(), 256, writer, red_lengths, red_codes);
+    write_code(blue.data(), 256, writer, blue_lengths, blue_codes);
+    write_code(alpha.data(), 256, writer, alpha_lengths, alpha_codes);
+    write_code(distance.data(), DISTANCE_CODES, writer, distance_lengths, distance_codes);
+
+    for (const Token& t : tokens) {
+        if (t.m_distance) {
+            const Prefix length = prefix(t.m_value);
+            writer.put(green_codes[256 + length.m_code], green_lengths[256 + length.m_code]);
+            writer.put(length.m_extra, length.m_extra_bits);
+            const Prefix dist = prefix(t.m_distance);
+            writer.put(distance_codes[dist.m_code], distance_lengths[dist.m_code]);
+            writer.put(dist.m_extra, dist.m_extra_bits);
+        } else {
+            const int g = channel(t.m_value, 8), r = channel(t.m_value, 16), b = channel(t.m_value, 0),
+                      a = channel(t.m_value, 24);
+            writer.put(green_codes[g], green_lengths[g]);
+            writer.put(red_codes[r], red_lengths[r]);
+            writer.put(blue_codes[b], blue_lengths[b]);
+            writer.put(alpha_codes[a], alpha_lengths[a]);
+        }
+    }
+}
+
+void put32le(std::vector<uint8_t>& out, uint32_t v) {
+    const uint8_t bytes[4] = {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)};
+    out.insert(out.end(), bytes, bytes + 4);
+}
+}  // namespace
+
+bool encode(const uint8_t* pixels, int width, int height, int channels, int stride, std::vector<uint8_t>& out) {
+    if (width < 1 || height < 1 || width > MAX_SIZE || height > MAX_SIZE) {
+        return false;
+    }
+    // the subtract green transform is applied while converting to ARGB
+    std::vector<uint32_t> argb(size_t(width) * height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = pixels + size_t(y) * stride;
+        uint32_t* dst = argb.data() + size_t(y) * width;
+        for (int x = 0; x < width; ++x, row += channels) {
+            const uint32_t g = channels >= 3 ? row[1] : row[0];
+            const uint32_t r = uint8_t(row[0] - g);
+            const uint32_t b = channels >= 3 ? uint8_t(row[2] - g) : 0;
+            const uint32_t a = channels == 4 ? row[3] : channels == 2 ? row[1] : 255;
+            dst[x] = a << 24 | r << 16 | g << 8 | b;
+        }
+    }
+    const std::vector<uint32_t> modes = apply_predictors(argb, width, height);
+
+    std::vector<uint8_t> data;
+    data.push_back(SIGNATURE);
+    BitWriter writer(data);
+    writer.put(width - 1, 14);
+    writer.put(height - 1, 14);
+    writer.put(channels == 2 || channels == 4 ? 1 : 0, 1);
+    // version
+    writer.put(0, 3);
+    // the decoder undoes the transforms in reverse order
+    writer.put(1, 1);
+    writer.put(SUBTRACT_GREEN, 2);
+    writer.put(1, 1);
+    writer.put(PREDICTOR, 2);
+    writer.put(PREDICTOR_BITS - 2, 3);
+    write_image(modes, (width + (1 << PREDICTOR_BITS) - 1) >> PREDICTOR_BITS, false, writer);
+    writer.put(0, 1);
+    write_image(argb, width, true, writer);
+    writer.flush();
+
+    const size_t padding = data.size() & 1;
+    out.clear();
+    out.reserve(20 + data.size() + padding);
+    out.insert(out.end(), {'R', 'I', 'F', 'F'});
+    put32le(out, uint32_t(12 + data.size() + padding));
+    out.insert(out.end(), {'W', 'E', 'B', 'P', 'V', 'P', '8', 'L'});
+    put32le(out, uint32_t(data.size()));
+    out.insert(out.end(), data.begin(), data.end());
+    if (padding) {
+        out.push_back(0);
+    }
+    return true;
+}
+}  // namespace WebP
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Lossless WebP (VP8L) files, smaller than PNG for rendered images at a similar encoding cost.
+namespace WebP {
+
+// largest width and height VP8L can store
+const int MAX_SIZE = 16384;
+
+// Encodes 8 bit gray, RGB or RGBA pixels as a lossless WebP file in out, rows in memory order. False when the image
+// is larger than MAX_SIZE either way.
+bool encode(const uint8_t* pixels, int width, int height, int channels, int stride, std::vector<uint8_t>& out);
+}  // namespace WebP
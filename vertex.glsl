@@ -7,6 +7,8 @@ in vec3 vNormal;
 out vec3 color;
 out vec3 normal;
 out vec3 vert2eye;
+// the same depth in the depth only prepass, which the shading pass tests for equality
+invariant gl_Position;
 void main() {
     gl_Position = MVP * vec4(vPosition, 1.0);
     color = vec3(0.8f,0.8f,0.8f);
@@ -0,0 +1,75 @@
+#version 400
+// The visibility buffer: a prepass of vertex.glsl with PREPASS writes the triangle of each pixel, then a full screen
+// triangle (FULLSCREEN) shades every covered pixel once with fragment.glsl, which RESOLVE is appended to.
+
+#ifdef PREPASS
+// 0 is left where there is no triangle
+out uint triangle;
+void main() {
+    triangle = uint(gl_PrimitiveID) + 1u;
+}
+#endif
+
+#ifdef FULLSCREEN
+void main() {
+    gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);
+}
+#endif
+
+#ifdef RESOLVE
+#undef main
+uniform mat4 MVP;
+uniform mat4 M;
+uniform vec3 Eye = vec3(1);
+// the region of the view in the framebuffer, x, y, width and height
+uniform vec4 Viewport;
+uniform usampler2D Triangles;
+// the vertex buffer as Vert, or as CompactVert when Compact is set
+uniform samplerBuffer Vertices;
+uniform usamplerBuffer CompactVertices;
+uniform bool Compact;
+// the element buffer, or none with Indexed unset
+uniform usamplerBuffer Indices;
+uniform bool Indexed;
+
+void fetch_vertex(uint index, out vec3 position, out vec3 vertex_normal) {
+    if (Compact) {
+        uvec3 v = texelFetch(CompactVertices, int(index)).xyz;
+        position = vec3(v.x & 0xffffu, v.x >> 16, v.y & 0xffffu) / 65535.0;
+        // signed 10 bit components, sign extended
+        ivec3 n = ivec3(uvec3(v.z << 22, v.z << 12, v.z << 2)) >> 22;
+        vertex_normal = max(vec3(n) / 511.0, -1.0);
+    } else {
+        position = texelFetch(Vertices, int(2u * index)).xyz;
+        vertex_normal = texelFetch(Vertices, int(2u * index + 1u)).xyz;
+    }
+}
+
+void main() {
+    vec2 pixel = gl_FragCoord.xy - Viewport.xy;
+    uint id = texelFetch(Triangles, ivec2(pixel), 0).r;
+    if (id == 0u) {
+        discard;
+    }
+    uint first = 3u * (id - 1u);
+    vec3 positions[3];
+    vec3 normals[3];
+    vec3 clip[3];
+    for (uint k = 0u; k < 3u; ++k) {
+        uint index = Indexed ? texelFetch(Indices, int(first + k)).r : first + k;
+        fetch_vertex(index, positions[k], normals[k]);
+        clip[k] = (MVP * vec4(positions[k], 1.0)).xyw;
+    }
+    // The pixel centre projects the mix of the clip positions with the perspective correct barycentrics, up to
+    // scale, so they solve clip * b = (ndc, 1).
+    vec2 ndc = pixel / Viewport.zw * 2.0 - 1.0;
+    vec3 b = inverse(mat3(clip[0], clip[1], clip[2])) * vec3(ndc, 1.0);
+    b /= b.x + b.y + b.z;
+    vec3 position = b.x * positions[0] + b.y * positions[1] + b.z * positions[2];
+    // what vertex.glsl passes on
+    color = vec3(0.8f,0.8f,0.8f);
+    normal = b.x * normals[0] + b.y * normals[1] + b.z * normals[2];
+    vert2eye = Eye - (vec4(position,1.0)*M).xyz;
+    shade_fragment();
+}
+#endif